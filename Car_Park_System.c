@@ -1,1055 +1,8820 @@
-/**
- * Car Park System
- * 
- * A console-based application for managing a car parking facility.
- * This system allows tracking of vehicles, parking spots, and fees.
- * 
- * Features:
- * - Parking spot management (100 spots)
- * - Vehicle entry and exit tracking
- * - Fee calculation based on parking duration
- * - Search functionality by owner name or license plate
- * - Data persistence using text files
- */
-
-#include <stdio.h>    // Standard input/output
-#include <stdlib.h>   // Standard library functions
-#include <string.h>   // String manipulation functions
-#include <windows.h>  // Windows API functions
-#include <conio.h>    // Console input/output
-#include <time.h>     // Time-related functions
-#include <ctype.h>    // Character type functions
-#include <math.h>     // Mathematical functions
-
-// Configure application to run as a Windows application
-#pragma comment(linker, "/SUBSYSTEM:WINDOWS /ENTRY:mainCRTStartup")
-
-// Constants for system configuration
-#define PARKING_SPOTS 100          // Total number of parking spots available
-#define FILENAME_SPOTS "parking_spots.txt"    // File to store parking spot data
-#define FILENAME_HISTORY "parking_history.txt"  // File to store parking history
-#define RATE_PER_SECOND 0.03       // Parking fee rate per second (Rs.)
-
-/**
- * Structure to store complete information about a car parking record
- * Used for maintaining the parking history and generating receipts
- */
-typedef struct
-{
-    char name[50];      // Owner's name
-    char plate[20];     // License plate number
-    char phone[15];     // Contact phone number
-    char address[100];  // Owner's address
-    int spot;           // Assigned parking spot number
-    time_t entry_time;  // Time when car entered the parking
-    time_t exit_time;   // Time when car exited (0 if still parked)
-    double fee;         // Calculated parking fee
-} CarRecord;
-
-/**
- * Structure to store information about individual parking spots
- * Used for tracking current parking status
- */
-typedef struct
-{
-    int spot;           // Parking spot number (1-100)
-    char plate[20];     // License plate of parked car (or "EMPTY")
-    int occupied;       // Flag indicating if spot is occupied (1) or empty (0)
-    time_t entry_time;  // Time when current car entered this spot
-} ParkingSpot;
-
-// Global variable for cursor positioning
-COORD coord = {0, 0};
-
-/**
- * Positions the cursor at specified coordinates in the console
- * 
- * @param x X-coordinate (column)
- * @param y Y-coordinate (row)
- */
-void gotoxy(int x, int y)
-{
-    coord.X = x;
-    coord.Y = y;
-    SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), coord);
-}
-
-/**
- * Sets the text color for console output
- * 
- * @param color Color code (Windows console color attribute)
- *              Common values: 10=green, 11=cyan, 12=red, 15=white
- */
-void setColor(int color)
-{
-    SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), color);
-}
-
-/**
- * Draws a rectangular border using ASCII extended characters
- * 
- * @param width Width of the border in characters
- * @param height Height of the border in characters
- * @param x X-coordinate of the top-left corner
- * @param y Y-coordinate of the top-left corner
- */
-void drawBorder(int width, int height, int x, int y)
-{
-    // Draw top border with corners
-    gotoxy(x, y);
-    printf("%c", 201);  // Top-left corner
-    for (int i = 0; i < width - 2; i++)
-        printf("%c", 205);  // Horizontal line
-    printf("%c", 187);  // Top-right corner
-
-    // Draw vertical borders
-    for (int i = 1; i < height - 1; i++)
-    {
-        gotoxy(x, y + i);
-        printf("%c", 186);  // Left vertical line
-        gotoxy(x + width - 1, y + i);
-        printf("%c", 186);  // Right vertical line
-    }
-
-    // Draw bottom border with corners
-    gotoxy(x, y + height - 1);
-    printf("%c", 200);  // Bottom-left corner
-    for (int i = 0; i < width - 2; i++)
-        printf("%c", 205);  // Horizontal line
-    printf("%c", 188);  // Bottom-right corner
-}
-
-/**
- * Initializes the parking spots data file
- * 
- * Creates a new parking spots file if it doesn't exist.
- * Each line in the file represents one parking spot with format:
- * [spot_number] [license_plate] [occupied_flag] [entry_time]
- */
-void initializeParkingSpots()
-{
-    FILE *file = fopen(FILENAME_SPOTS, "r");
-    if (file == NULL)
-    {
-        // File doesn't exist, create it with all spots empty
-        file = fopen(FILENAME_SPOTS, "w");
-        for (int i = 0; i < PARKING_SPOTS; i++)
-        {
-            fprintf(file, "%d EMPTY 0 0\n", i + 1);
-        }
-        fclose(file);
-    }
-    else
-    {
-        // File exists, no need to initialize
-        fclose(file);
-    }
-}
-
-/**
- * Displays the welcome screen with loading animation
- * 
- * Shows a welcome message and animated loading bar when the application starts
- */
-void welcomeScreen()
-{
-    system("cls");  // Clear the screen
-    setColor(11);   // Set text color to cyan
-    drawBorder(60, 10, 10, 5);  // Draw border for welcome message
-
-    // Display welcome messages
-    gotoxy(25, 8);
-    printf("WELCOME TO CAR PARK SYSTEM");
-    gotoxy(22, 10);
-    printf("Loading Parking Management System");
-
-    // Display animated loading bar
-    gotoxy(15, 13);
-    for (int i = 0; i < 50; i++)
-    {
-        printf("%c", 177);  // Block character for loading bar
-        Sleep(50);          // Delay for animation effect
-    }
-    Sleep(1000);  // Pause before proceeding to main menu
-}
-
-
-/**
- * Displays the exit screen with animation
- * 
- * Shows a goodbye message and animated "Exiting" text when the application closes
- */
-void exitScreen()
-{
-    system("cls");  // Clear the screen
-    setColor(12);   // Set text color to red
-    drawBorder(60, 10, 10, 5);  // Draw border for exit message
-
-    // Display credits
-    gotoxy(30, 8);
-    printf("Made by A Little Mouse");
-    
-    // Animated exit message
-    gotoxy(35, 12);
-    printf("Exiting.");
-    Sleep(2000);
-    gotoxy(35, 12);
-    printf("Exiting..");
-    Sleep(2000);
-    gotoxy(35, 12);
-    printf("Exiting...");
-    Sleep(2000);
-
-    system("cls");  // Clear screen before exit
-}
-
-/**
- * Displays ASCII art of a car at specified coordinates
- * 
- * @param x X-coordinate for the top-left corner of the car art
- * @param y Y-coordinate for the top-left corner of the car art
- */
-void displayCarArt(int x, int y)
-{
-    gotoxy(x, y++);
-    printf("   ______");        // Car roof
-    gotoxy(x, y++);
-    printf("  /|_||_\\`.__");    // Car windows and top
-    gotoxy(x, y++);
-    printf(" (   _    _ _\\");   // Car body
-    gotoxy(x, y++);
-    printf("=`-(_)--(_)-'");    // Car wheels
-}
-
-/**
- * Counts the number of currently parked cars
- * 
- * Reads the parking spots file and counts occupied spots
- * 
- * @return Number of currently parked cars
- */
-int countParkedCars()
-{
-    FILE *file = fopen(FILENAME_SPOTS, "r");
-    if (file == NULL)
-        return 0;  // Return 0 if file cannot be opened
-    
-    ParkingSpot spot;
-    int count = 0;
-    // Read each spot record and count occupied spots
-    while (fscanf(file, "%d %19s %d %ld", &spot.spot, spot.plate, &spot.occupied, &spot.entry_time) == 4)
-    {
-        if (spot.occupied)
-            count++;
-    }
-    fclose(file);
-    return count;
-}
-
-/**
- * Displays the main menu with all available options
- * 
- * Shows the main menu interface with car art and current parking status
- */
-void mainMenu()
-{
-    system("cls");  // Clear the screen
-    setColor(10);   // Set text color to green
-    drawBorder(60, 20, 10, 3);  // Draw border for menu
-    displayCarArt(20, 5);  // Display car ASCII art
-    
-    // Display menu title and options
-    gotoxy(30, 8);
-    printf("MAIN MENU");
-    gotoxy(25, 10);
-    printf("1. Display Parking Status");
-    gotoxy(25, 11);
-    printf("2. Add Car");
-    gotoxy(25, 12);
-    printf("3. Remove Car");
-    gotoxy(25, 13);
-    printf("4. Search Records");
-    gotoxy(25, 14);
-    printf("5. Exit System");
-
-    // Prompt for user input
-    gotoxy(25, 16);
-    printf("Enter your choice (1-5): ");
-    
-    // Display current parking status
-    gotoxy(25, 20);
-    printf("Cars Parked: %d", countParkedCars());
-    
-    // Position cursor at input position
-    gotoxy(50,16);
-}
-
-/**
- * Displays the current status of all parking spots
- * 
- * Shows a visual grid of all parking spots with their status (occupied or available)
- * Occupied spots are shown in red with [X], available spots show their spot number in green
- */
-void displayParkingStatus()
-{
-    system("cls");  // Clear the screen
-    setColor(15);   // Set text color to white
-    drawBorder(82, 27, 5, 2);  // Draw border for parking display
-    
-    // Ensure parking spots file exists
-    initializeParkingSpots();
-    
-    // Open parking spots file
-    FILE *file = fopen(FILENAME_SPOTS, "r");
-    if (file == NULL)
-    {
-        printf("Error loading parking data!");
-        return;
-    }
-
-    // Display title
-    gotoxy(40, 4);
-    printf("PARKING STATUS");
-    gotoxy(12, 5);
-
-    // Load all parking spots data into memory
-    ParkingSpot spots[PARKING_SPOTS];
-    for (int i = 0; i < PARKING_SPOTS; i++)
-    {
-        fscanf(file, "%d %19s %d %ld", &spots[i].spot, spots[i].plate,
-               &spots[i].occupied, &spots[i].entry_time);
-    }
-    fclose(file);
-
-    // Display parking spots in a grid layout (10x10)
-    for (int i = 0; i < PARKING_SPOTS; i++)
-    {
-        // Calculate position in grid (10 columns)
-        int row = 8 + (i / 10) * 2;  // New row every 10 spots, with spacing
-        int col = 10 + (i % 10) * 7; // 7 characters width per spot
-
-        gotoxy(col, row);
-        if (spots[i].occupied)
-        {
-            setColor(12);  // Red for occupied spots
-            printf("[ X ]");
-        }
-        else
-        {
-            setColor(10);  // Green for available spots
-            printf("[%3d]", spots[i].spot);
-        }
-    }
-
-    // Prompt to return to main menu
-    setColor(15);  // White text
-    gotoxy(10, 27);
-    printf("Press any key to return to main menu...");
-    getch();  // Wait for key press
-}
-
-/**
- * Adds a new car to the parking system
- * 
- * Collects car and owner information, validates input data,
- * assigns a parking spot, and updates both the parking spots
- * and history files
- */
-void addCar()
-{
-    system("cls");  // Clear the screen
-    drawBorder(60, 20, 10, 3);  // Draw border for input form
-    displayCarArt(20, 5);  // Display car ASCII art
-    
-    CarRecord newCar;  // Structure to store new car information
-    time_t now = time(NULL);  // Current timestamp
-    gotoxy(25, 8);
-    printf("ADD NEW CAR ENTRY");
-
-    // Get Owner Name
-    do
-    {
-        gotoxy(20, 10);
-        printf("Owner Name:            ");
-        gotoxy(33, 10);
-        fflush(stdin);
-        fgets(newCar.name, 50, stdin);
-        newCar.name[strcspn(newCar.name, "\n")] = 0;
-        if (strlen(newCar.name) == 0)
-        {
-            gotoxy(20, 16);
-            setColor(12);
-            printf("Name cannot be empty!");
-            Sleep(1000);
-            gotoxy(20, 16);
-            printf("                         ");
-        }
-    } while (strlen(newCar.name) == 0);
-
-    // Check for existing plates
-    ParkingSpot spots[PARKING_SPOTS];
-    FILE *file = fopen(FILENAME_SPOTS, "r");
-    for (int i = 0; i < PARKING_SPOTS; i++)
-    {
-        fscanf(file, "%d %19s %d %ld", &spots[i].spot, spots[i].plate,
-               &spots[i].occupied, &spots[i].entry_time);
-    }
-    fclose(file);
-
-    // Get License Plate
-    int plateExists = 0;
-    do
-    {
-        plateExists = 0;
-        gotoxy(20, 11);
-        printf("License Plate:          ");
-        gotoxy(35, 11);
-        fflush(stdin);
-        fgets(newCar.plate, 20, stdin);
-        newCar.plate[strcspn(newCar.plate, "\n")] = 0;
-
-        for (int i = 0; i < PARKING_SPOTS; i++)
-        {
-            if (stricmp(spots[i].plate, newCar.plate) == 0 && spots[i].occupied)
-            {
-                plateExists = 1;
-                break;
-            }
-        }
-
-        if (plateExists)
-        {
-            gotoxy(20, 16);
-            setColor(12);
-            printf("Car already parked! Exiting...");
-            Sleep(2000);
-            return;
-        }
-        else if (strlen(newCar.plate) == 0)
-        {
-            gotoxy(20, 16);
-            setColor(12);
-            printf("Plate cannot be empty!");
-            Sleep(1000);
-            gotoxy(20, 16);
-            printf("                         ");
-        }
-    } while (strlen(newCar.plate) == 0);
-
-    // Get Phone Number
-    int validPhone = 0;
-    setColor(10);
-    do
-    {
-        gotoxy(20, 12);
-        printf("Phone Number:          ");
-        gotoxy(35, 12);
-        fflush(stdin);
-        fgets(newCar.phone, 15, stdin);
-        newCar.phone[strcspn(newCar.phone, "\n")] = 0;
-
-        validPhone = 1;
-        if (strlen(newCar.phone) != 10)
-            validPhone = 0;
-        for (int i = 0; i < strlen(newCar.phone); i++)
-        {
-            if (!isdigit(newCar.phone[i]))
-            {
-                validPhone = 0;
-                break;
-            }
-        }
-
-        if (!validPhone)
-        {
-            gotoxy(20, 16);
-            setColor(12);
-            printf("Invalid phone! 10 digits required!");
-            Sleep(1000);
-            gotoxy(20, 16);
-            printf("                                    ");
-        }
-    } while (!validPhone);
-
-    // Get Address
-    setColor(10);
-    do
-    {
-        gotoxy(20, 13);
-        printf("Address:             ");
-        gotoxy(30, 13);
-        fflush(stdin);
-        fgets(newCar.address, 100, stdin);
-        newCar.address[strcspn(newCar.address, "\n")] = 0;
-        if (strlen(newCar.address) == 0)
-        {
-            gotoxy(20, 16);
-            setColor(12);
-            printf("Address cannot be empty!");
-            Sleep(1000);
-            gotoxy(20, 16);
-            printf("                       ");
-        }
-    } while (strlen(newCar.address) == 0);
-
-    // Get Parking Spot
-    int valid = 0;
-    char input[10];
-    setColor(10);
-    do
-    {
-        gotoxy(20, 14);
-        printf("Parking Spot (1-100): ");
-        gotoxy(41, 14);
-        printf("      ");
-        gotoxy(41, 14);
-        fflush(stdin);
-        fgets(input, 10, stdin);
-        if (sscanf(input, "%d", &newCar.spot) != 1)
-        {
-            gotoxy(20, 16);
-            setColor(12);
-            printf("Invalid number input!");
-            Sleep(1000);
-            gotoxy(20, 16);
-            printf("                        ");
-            continue;
-        }
-
-        valid = 0;
-        for (int i = 0; i < PARKING_SPOTS; i++)
-        {
-            if (spots[i].spot == newCar.spot && !spots[i].occupied)
-            {
-                valid = 1;
-                break;
-            }
-        }
-
-        if (!valid)
-        {
-            gotoxy(20, 16);
-            setColor(12);
-            printf("Invalid or occupied spot!");
-            Sleep(1000);
-            gotoxy(20, 16);
-            printf("                             ");
-        }
-    } while (!valid);
-
-    // Update parking spots
-    for (int i = 0; i < PARKING_SPOTS; i++)
-    {
-        if (spots[i].spot == newCar.spot)
-        {
-            spots[i].occupied = 1;
-            strcpy(spots[i].plate, newCar.plate);
-            spots[i].entry_time = now;
-            break;
-        }
-    }
-
-    file = fopen(FILENAME_SPOTS, "w");
-    for (int i = 0; i < PARKING_SPOTS; i++)
-    {
-        fprintf(file, "%d %s %d %ld\n", spots[i].spot, spots[i].plate,
-                spots[i].occupied, spots[i].entry_time);
-    }
-    fclose(file);
-
-    // Update history
-    file = fopen(FILENAME_HISTORY, "a");
-    newCar.entry_time = now;
-    newCar.exit_time = 0;
-    newCar.fee = 0.0;
-    fprintf(file, "%s,%s,%s,%s,%d,%ld,%ld,%.2f\n",
-            newCar.name, newCar.plate, newCar.phone,
-            newCar.address, newCar.spot, newCar.entry_time,
-            newCar.exit_time, newCar.fee);
-    fclose(file);
-
-    gotoxy(20, 16);
-    setColor(10);
-    printf("Entry added successfully!");
-    gotoxy(20, 17);
-    printf("Press any key to return...");
-    getch();
-}
-
-/**
- * Removes a car from the parking system
- * 
- * Gets the license plate of the car to remove, calculates parking fee,
- * updates parking spots and history files, and displays a receipt
- */
-void removeCar()
-{
-    system("cls");  // Clear the screen
-    setColor(15);   // Set text color to white
-    drawBorder(60, 20, 10, 3);  // Draw border for form
-    displayCarArt(20, 5);  // Display car ASCII art
-
-    // Check if there are any parked cars
-    int parkedCars = countParkedCars();
-    if (parkedCars == 0)
-    {
-        gotoxy(20, 10);
-        setColor(12);  // Red text for error
-        printf("No cars parked!");
-        Sleep(1500);
-        return;
-    }
-
-    char plate[20];
-    time_t exit_time = time(NULL);
-    gotoxy(25, 8);
-    printf("REMOVE CAR FROM PARKING");
-
-    // Get license plate
-    do
-    {
-        gotoxy(20, 10);
-        printf("Enter License Plate: ");
-        gotoxy(40, 10);
-        printf("                    ");
-        gotoxy(40, 10);
-        fflush(stdin);
-        fgets(plate, 20, stdin);
-        plate[strcspn(plate, "\n")] = 0;
-        if (strlen(plate) == 0)
-        {
-            gotoxy(20, 12);
-            setColor(12);
-            printf("Plate cannot be empty!");
-            Sleep(1000);
-            gotoxy(20, 12);
-            printf("                        ");
-        }
-    } while (strlen(plate) == 0);
-
-    // Load parking spots
-    ParkingSpot spots[PARKING_SPOTS];
-    FILE *file = fopen(FILENAME_SPOTS, "r");
-    if (file == NULL)
-    {
-        gotoxy(20, 12);
-        printf("Error loading parking data!");
-        getch();
-        return;
-    }
-
-    for (int i = 0; i < PARKING_SPOTS; i++)
-    {
-        fscanf(file, "%d %19s %d %ld", &spots[i].spot, spots[i].plate,
-               &spots[i].occupied, &spots[i].entry_time);
-    }
-    fclose(file);
-
-    // Find and remove car
-    int found = 0;
-    double fee = 0.0;
-    time_t entry_time = 0;
-
-    for (int i = 0; i < PARKING_SPOTS; i++)
-    {
-        if (stricmp(spots[i].plate, plate) == 0 && spots[i].occupied)
-        {
-            entry_time = spots[i].entry_time;
-            time_t duration = exit_time - entry_time;
-            fee = duration * RATE_PER_SECOND;
-
-            spots[i].occupied = 0;
-            strcpy(spots[i].plate, "EMPTY");
-            spots[i].entry_time = 0;
-            found = 1;
-            break;
-        }
-    }
-
-    if (!found)
-    {
-        gotoxy(20, 12);
-        setColor(12);
-        printf("Invalid car entry!");
-        Sleep(3000);
-        return;
-    }
-
-    // Save updated spots
-    file = fopen(FILENAME_SPOTS, "w");
-    for (int i = 0; i < PARKING_SPOTS; i++)
-    {
-        fprintf(file, "%d %s %d %ld\n", spots[i].spot, spots[i].plate,
-                spots[i].occupied, spots[i].entry_time);
-    }
-    fclose(file);
-
-    // Update history
-    FILE *histFile = fopen(FILENAME_HISTORY, "r+");
-    if (histFile != NULL)
-    {
-        char line[256];
-        long pos = 0;
-        while (fgets(line, sizeof(line), histFile))
-        {
-            CarRecord record;
-            sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld,%lf",
-                   record.name, record.plate, record.phone,
-                   record.address, &record.spot, &record.entry_time,
-                   &record.exit_time, &record.fee);
-
-            if (strcmp(record.plate, plate) == 0 && record.exit_time == 0)
-            {
-                record.exit_time = exit_time;
-                record.fee = fee;
-
-                fseek(histFile, pos, SEEK_SET);
-                fprintf(histFile, "%s,%s,%s,%s,%d,%ld,%ld,%.2f\n",
-                        record.name, record.plate, record.phone,
-                        record.address, record.spot, record.entry_time,
-                        record.exit_time, record.fee);
-                break;
-            }
-            pos = ftell(histFile);
-        }
-        fclose(histFile);
-    }
-
-    // Display receipt
-    gotoxy(20, 12);
-    setColor(10);
-    printf("Car removed successfully!");
-    gotoxy(20, 13);
-    printf("Entry Time:  %s", ctime(&entry_time));
-    gotoxy(20, 14);
-    printf("Exit Time:   %s", ctime(&exit_time));
-    gotoxy(20, 15);
-    printf("Parking Duration: %lld seconds", (long long)(exit_time - entry_time));
-    gotoxy(20, 16);
-    printf("Total Fee:   Rs,%.2f (Rs,0.03/sec)", fee);
-    gotoxy(20, 18);
-    printf("Press any key to return...");
-    getch();
-}
-
-/**
- * Searches parking history by owner name
- * 
- * Finds all parking records for a specific owner and displays
- * summary information including total entries and unique vehicles
- */
-void searchByName()
-{
-    system("cls");  // Clear the screen
-    char name[50];  // Buffer for owner name input
-    drawBorder(60, 25, 10, 3);  // Draw border for search form
-    displayCarArt(20, 5);  // Display car ASCII art
-
-    gotoxy(25, 8);
-    printf("SEARCH BY OWNER NAME");
-
-    // Get name with validation
-    do
-    {
-        gotoxy(20, 10);
-        printf("Enter Owner Name: ");
-        gotoxy(38, 10);
-        printf("                    ");
-        gotoxy(38, 10);
-        fflush(stdin);
-        fgets(name, 50, stdin);
-        name[strcspn(name, "\n")] = 0;
-        if (strlen(name) == 0)
-        {
-            gotoxy(20, 12);
-            setColor(12);
-            printf("Name cannot be empty!");
-            Sleep(1000);
-            gotoxy(20, 12);
-            printf("                        ");
-        }
-    } while (strlen(name) == 0);
-
-    FILE *file = fopen(FILENAME_HISTORY, "r");
-    if (file == NULL)
-    {
-        gotoxy(20, 12);
-        printf("No history records found!");
-        getch();
-        return;
-    }
-
-    int totalEntries = 0;
-    char plates[10][20] = {0};
-    int plateCount = 0;
-    char line[256];
-
-    while (fgets(line, sizeof(line), file))
-    {
-        CarRecord record;
-        sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld",
-               record.name, record.plate, record.phone,
-               record.address, &record.spot, &record.entry_time, &record.exit_time);
-
-        if (stricmp(record.name, name) == 0)
-        {
-            totalEntries++;
-
-            int isNew = 1;
-            for (int i = 0; i < plateCount; i++)
-            {
-                if (stricmp(plates[i], record.plate) == 0)
-                {
-                    isNew = 0;
-                    break;
-                }
-            }
-
-            if (isNew && plateCount < 10)
-            {
-                strcpy(plates[plateCount++], record.plate);
-            }
-        }
-    }
-    fclose(file);
-
-    gotoxy(20, 12);
-    printf("Parking History for: %s", name);
-    gotoxy(20, 13);
-    printf("Total Times Parked: %d", totalEntries);
-    gotoxy(20, 14);
-    printf("Unique Vehicles: %d", plateCount);
-
-    gotoxy(20, 16);
-    printf("License Plates Used:");
-    for (int i = 0; i < plateCount; i++)
-    {
-        gotoxy(22, 17 + i);
-        printf("%d. %s", i + 1, plates[i]);
-    }
-
-    gotoxy(20, 22);
-    printf("Press any key to return...");
-    getch();
-}
-
-/**
- * Searches parking history by license plate
- * 
- * Finds all parking records for a specific vehicle and displays
- * summary information including total entries and all registered owners
- */
-void searchByPlate()
-{
-    system("cls");  // Clear the screen
-    char plate[20]; // Buffer for license plate input
-    drawBorder(60, 25, 10, 3);  // Draw border for search form
-    displayCarArt(20, 5);  // Display car ASCII art
-
-    gotoxy(25, 8);
-    printf("SEARCH BY LICENSE PLATE");
-
-    // Get plate with validation
-    do
-    {
-        gotoxy(20, 10);
-        printf("Enter License Plate: ");
-        gotoxy(40, 10);
-        printf("                    ");
-        gotoxy(40, 10);
-        fflush(stdin);
-        fgets(plate, 20, stdin);
-        plate[strcspn(plate, "\n")] = 0;
-        if (strlen(plate) == 0)
-        {
-            gotoxy(20, 12);
-            setColor(12);
-            printf("Plate cannot be empty!");
-            Sleep(1000);
-            gotoxy(20, 12);
-            printf("                        ");
-        }
-    } while (strlen(plate) == 0);
-
-    FILE *file = fopen(FILENAME_HISTORY, "r");
-    if (file == NULL)
-    {
-        gotoxy(20, 12);
-        printf("No history records found!");
-        getch();
-        return;
-    }
-
-    int totalEntries = 0;
-    char names[10][50] = {0};
-    int nameCount = 0;
-    char line[256];
-
-    while (fgets(line, sizeof(line), file))
-    {
-        CarRecord record;
-        sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld",
-               record.name, record.plate, record.phone,
-               record.address, &record.spot, &record.entry_time, &record.exit_time);
-
-        if (stricmp(record.plate, plate) == 0)
-        {
-            totalEntries++;
-
-            int isNew = 1;
-            for (int i = 0; i < nameCount; i++)
-            {
-                if (stricmp(names[i], record.name) == 0)
-                {
-                    isNew = 0;
-                    break;
-                }
-            }
-
-            if (isNew && nameCount < 10)
-            {
-                strcpy(names[nameCount++], record.name);
-            }
-        }
-    }
-    fclose(file);
-
-    gotoxy(20, 12);
-    printf("Parking History for: %s", plate);
-    gotoxy(20, 13);
-    printf("Total Entries: %d", totalEntries);
-
-    gotoxy(20, 15);
-    printf("Registered Owners:");
-    for (int i = 0; i < nameCount; i++)
-    {
-        gotoxy(22, 16 + i);
-        printf("%d. %s", i + 1, names[i]);
-    }
-
-    gotoxy(20, 22);
-    printf("Press any key to return...");
-    getch();
-}
-
-/**
- * Displays the search menu with options to search by name or license plate
- * 
- * Provides a submenu for different search options and handles user input
- */
-void searchMenu()
-{
-    char choice;
-    do
-    {
-        system("cls");  // Clear the screen
-        setColor(11);   // Set text color to cyan
-        drawBorder(60, 20, 10, 3);  // Draw border for menu
-        displayCarArt(20, 5);  // Display car ASCII art
-
-        // Display search menu options
-        gotoxy(30, 8);
-        printf("SEARCH MENU");
-        gotoxy(25, 10);
-        printf("1. Search by Owner Name");
-        gotoxy(25, 11);
-        printf("2. Search by License Plate");
-        gotoxy(25, 12);
-        printf("3. Return to Main Menu");
-        gotoxy(25, 14);
-        printf("Enter your choice (1-3): ");
-
-        // Get user choice and process it
-        choice = getche();  // Get character without waiting for Enter
-        system("cls");
-
-        // Handle user selection
-        switch (choice)
-        {
-        case '1':
-            searchByName();  // Search records by owner name
-            break;
-        case '2':
-            searchByPlate(); // Search records by license plate
-            break;
-        case '3':
-            return;  // Return to main menu
-        default:
-            gotoxy(25, 16);
-            printf("Invalid choice!");
-            Sleep(1000);
-        }
-    } while (choice != '3');  // Continue until user chooses to return
-}
-
-/**
- * Main function - Entry point of the application
- * 
- * Sets up the console environment, initializes the system,
- * and handles the main program loop
- * 
- * @return 0 on successful execution
- */
-int main()
-{
-    // Set up console for Windows GUI application
-    AllocConsole();
-    freopen("CONIN$", "r", stdin);     // Redirect standard input
-    freopen("CONOUT$", "w", stdout);   // Redirect standard output
-    freopen("CONOUT$", "w", stderr);   // Redirect standard error
-
-    // Set console title
-    SetConsoleTitleA("Car Park System");
-    system("title Car Park System");
-
-    // Set console size and buffer
-    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-    COORD size = {90, 30};  // Width and height of console buffer
-    SetConsoleScreenBufferSize(hConsole, size);
-
-    // Set console window size
-    SMALL_RECT rect = {0, 0, 89, 29};  // Left, top, right, bottom coordinates
-    SetConsoleWindowInfo(hConsole, TRUE, &rect);
-
-    // Initialize system and display welcome screen
-    initializeParkingSpots();  // Create or verify parking spots file
-    welcomeScreen();           // Show welcome animation
-
-    // Main program loop
-    int running = 1;
-    while (running)
-    {
-        mainMenu();  // Display main menu options
-        char choice = getche();  // Get user selection without waiting for Enter
-
-        // Process user selection
-        switch (choice)
-        {
-        case '1':
-            displayParkingStatus();  // Show parking spot grid
-            break;
-        case '2':
-            addCar();  // Add a new car to parking
-            break;
-        case '3':
-            removeCar();  // Remove a car from parking
-            break;
-        case '4':
-            searchMenu();  // Show search submenu
-            break;
-        case '5':
-            running = 0;  // Exit the program
-            break;
-        default:
-            // Handle invalid input
-            gotoxy(25, 18);
-            setColor(12);  // Red text for error
-            printf("Invalid choice!");
-            Sleep(1000);
-        }
-    }
-
-    // Show exit screen and terminate
-    exitScreen();
-    return 0;
+/**
+ * Car Park System
+ * 
+ * A console-based application for managing a car parking facility.
+ * This system allows tracking of vehicles, parking spots, and fees.
+ * 
+ * Features:
+ * - Parking spot management (100 spots)
+ * - Vehicle entry and exit tracking
+ * - Fee calculation based on parking duration
+ * - Search functionality by owner name or license plate
+ * - Data persistence using text files
+ */
+
+#include <stdio.h>    // Standard input/output
+#include <stdlib.h>   // Standard library functions
+#include <string.h>   // String manipulation functions
+#include <stdarg.h>   // Variable argument lists
+#include <time.h>     // Time-related functions
+#include <ctype.h>    // Character type functions
+#include <math.h>     // Mathematical functions
+#include <stdint.h>   // Fixed-width integers for the column store
+#include <limits.h>   // LONG_MAX
+
+#ifdef _WIN32
+#include <windows.h>  // Windows API functions
+#include <conio.h>    // Console input/output
+#include <io.h>       // Low-level file handles (_commit)
+#include <direct.h>   // _mkdir
+
+// Configure application to run as a Windows application
+#pragma comment(linker, "/SUBSYSTEM:WINDOWS /ENTRY:mainCRTStartup")
+#else
+#include <unistd.h>   // POSIX I/O (fsync, usleep)
+#include <termios.h>  // Terminal modes for single-key input
+#include <pthread.h>  // POSIX threads
+#include <strings.h>  // strcasecmp
+#include <poll.h>     // Waiting on several descriptors
+#include <sys/stat.h> // mkdir
+#include <sys/file.h> // flock
+#include <fcntl.h>    // open
+#include <errno.h>    // EINTR
+#ifdef __linux__
+#include <sys/inotify.h>  // File change notifications
+#endif
+
+#define stricmp strcasecmp
+#endif
+
+// Console screen size used by all screens
+#define SCREEN_WIDTH 90
+#define SCREEN_HEIGHT 30
+#define NOTICE_MS 2000  // How long validation and status messages stay on screen
+
+// Constants for system configuration
+#define PARKING_SPOTS 100          // Total number of parking spots available
+#define FILENAME_SPOTS "parking_spots.txt"    // File to store parking spot data
+#define FILENAME_HISTORY "parking_history.txt"  // File to store parking history
+#define RATE_PER_SECOND 0.03       // Parking fee rate per second (Rs.)
+#define PARKING_LEVELS 4           // Floors the spots are spread over
+#define SPOTS_PER_LEVEL (PARKING_SPOTS / PARKING_LEVELS)  // Spots 1-25 on level 1, ...
+
+// Columnar history store used by the reports
+#define FILENAME_COLUMNS "history_columns.bin"  // Closed sessions, one compressed column per field
+#define FILENAME_OWNERS "history_owners.txt"    // Owner names by id for the column store
+#define FILENAME_STATEMENTS "owner_statements.txt"  // Output of the statements command
+#define FILENAME_RESERVATIONS "reservations.txt"    // Advance bookings, append-only
+#define FILENAME_FACILITIES "facilities.txt"  // Sites served by this process: id,directory per line
+#define FILENAME_LOCK "car_park.lock"         // Locked by every process writing spots or history
+#define HISTORY_MARKER_SLOTS 16               // Recent history writes whose offsets the lock file keeps
+#define MAX_FACILITIES 64                     // Sites one process can serve
+#define DATA_PATH_MAX 320                     // Facility directory plus data file name
+
+// Group commit settings for spot and history writes
+#define GROUP_COMMIT_MAX_BATCH 64     // Most events written (and synced) together
+#define GROUP_COMMIT_MAX_DELAY_MS 5   // Longest the first event waits for batch-mates
+#define GROUP_COMMIT_SYNC 1           // 1 = flush each batch to disk before acknowledging
+
+// Instrumentation (set METRICS_ENABLED to 0 to compile it out entirely)
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
+#define FILENAME_METRICS "car_park_metrics.prom"  // Prometheus text file the console writes to its facility
+#define METRICS_EXPORT_MS 10000                   // How often the console rewrites it
+
+#define RESERVATION_HOLD_MINUTES 120  // A walk-in may not take a bay booked to start this soon
+
+#define SIM_DIRECTORY "simulation"      // Scratch facility the simulator runs in (wiped first)
+#define FILENAME_SIM_MARKER "simulator_scratch.txt"  // Marks SIM_DIRECTORY as made by the simulator
+#define SIM_START_TIME 1736121600L      // Virtual clock start: Monday 2025-01-06 00:00 UTC
+#define SIM_DEFAULT_RATE 5000           // Mean arrivals per hour
+#define SIM_DEFAULT_HOURS 24            // Simulated time
+#define SIM_DEFAULT_DWELL_MINUTES 120   // Mean stay
+#define SIM_LOGNORMAL_SIGMA 0.8         // Spread of log-normal stays
+
+// Consistency check of spot state against open history sessions
+#define VERIFY_ON_BOOT_REPAIR 0                 // 1 = the console repairs at startup, 0 = only reports
+#define VERIFY_MIN_CHUNK_BYTES (4 * 1024 * 1024)  // Smallest history slice given to a scan thread
+#define VERIFY_MAX_THREADS 64                   // Upper limit for scan threads (one per CPU)
+#define VERIFY_MAX_LISTED 20                    // Discrepancies listed in the report
+
+// Retention of personal data in the history
+#define RETENTION_DAYS 365                      // Closed sessions older than this are expired
+#define RETENTION_DELETE 0                      // 1 = remove expired rows, 0 = anonymize them
+#define RETENTION_INTERVAL_MS (60 * 60 * 1000)  // How often the console compacts the history
+#define RETENTION_MAX_BYTES_PER_SEC (4L * 1024 * 1024)  // Background read throttle
+#define RETENTION_THROTTLE_STEP (64 * 1024)     // Bytes between throttle checks (and copy checkpoints)
+#define RETENTION_MAX_ATTEMPTS 3                // Copies of a prefix changed meanwhile before giving up
+#define FILENAME_RETENTION_LOCK "car_park.retention.lock"  // Held by the one process compacting
+#define RETENTION_ANONYMOUS_NAME "-"            // Replacement owner name
+#define RETENTION_ANONYMOUS_PHONE "0000000000"  // Replacement phone (same length as a real one)
+#define RETENTION_ANONYMOUS_ADDRESS "-"         // Replacement address
+
+/*
+ * Platform layer
+ *
+ * Thin wrappers over Win32 and POSIX threads, locks, clocks and console
+ * input so the rest of the program is written once for both.
+ */
+#ifdef _WIN32
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+typedef HANDLE Thread;
+typedef LPTHREAD_START_ROUTINE ThreadFunc;
+typedef HANDLE FileLock;
+#define THREAD_RETURN DWORD WINAPI
+#else
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+typedef pthread_t Thread;
+typedef void *(*ThreadFunc)(void *);
+typedef int FileLock;
+#define THREAD_RETURN void *
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define THREAD_LOCAL __declspec(thread)  // Variable with one copy per thread
+#define POPCOUNT64(x) ((int)__popcnt64(x))  // Set bits in a 64-bit word
+static __inline int lowestBit64(uint64_t x)
+{
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+}
+#define LOWEST_BIT64(x) lowestBit64(x)  // Index of the lowest set bit (x != 0)
+#else
+#define THREAD_LOCAL __thread
+#define POPCOUNT64(x) __builtin_popcountll(x)
+#define LOWEST_BIT64(x) __builtin_ctzll(x)
+#endif
+
+#define WAIT_FOREVER 0xFFFFFFFFu  // Timeout value for condWait() with no limit
+
+/**
+ * Initializes a mutex
+ *
+ * @param mutex Mutex to initialize
+ */
+void mutexInit(Mutex *mutex)
+{
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+/**
+ * Acquires a mutex
+ *
+ * @param mutex Mutex to lock
+ */
+void mutexLock(Mutex *mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+/**
+ * Releases a mutex
+ *
+ * @param mutex Mutex to unlock
+ */
+void mutexUnlock(Mutex *mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+/**
+ * Initializes a condition variable
+ *
+ * @param cond Condition variable to initialize
+ */
+void condInit(CondVar *cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+/**
+ * Waits on a condition variable with the mutex held
+ *
+ * @param cond Condition variable to wait on
+ * @param mutex Mutex held by the caller
+ * @param timeoutMs Longest wait in milliseconds, or WAIT_FOREVER
+ */
+void condWait(CondVar *cond, Mutex *mutex, unsigned timeoutMs)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, timeoutMs == WAIT_FOREVER ? INFINITE : timeoutMs);
+#else
+    if (timeoutMs == WAIT_FOREVER)
+    {
+        pthread_cond_wait(cond, mutex);
+        return;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(cond, mutex, &deadline);
+#endif
+}
+
+/**
+ * Wakes one thread waiting on a condition variable
+ *
+ * @param cond Condition variable to signal
+ */
+void condSignal(CondVar *cond)
+{
+#ifdef _WIN32
+    WakeConditionVariable(cond);
+#else
+    pthread_cond_signal(cond);
+#endif
+}
+
+/**
+ * Wakes all threads waiting on a condition variable
+ *
+ * @param cond Condition variable to signal
+ */
+void condBroadcast(CondVar *cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+/**
+ * Starts a thread
+ *
+ * @param thread Receives the thread handle
+ * @param func Thread entry point (declared with THREAD_RETURN)
+ * @param arg Argument passed to the entry point
+ * @return 1 on success, 0 on failure
+ */
+int threadStart(Thread *thread, ThreadFunc func, void *arg)
+{
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+    return *thread != NULL;
+#else
+    return pthread_create(thread, NULL, func, arg) == 0;
+#endif
+}
+
+/**
+ * Releases a thread handle; the thread keeps running on its own
+ *
+ * @param thread Thread started with threadStart()
+ */
+void threadDetach(Thread thread)
+{
+#ifdef _WIN32
+    CloseHandle(thread);
+#else
+    pthread_detach(thread);
+#endif
+}
+
+/**
+ * Waits for a thread to finish and releases it
+ *
+ * @param thread Thread started with threadStart()
+ */
+void threadJoin(Thread thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+/**
+ * Returns the number of processors available
+ *
+ * @return Processor count, at least 1
+ */
+int cpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+/**
+ * Replaces a file with another one in a single step
+ *
+ * @param from Newly written file
+ * @param to File to replace
+ * @return 1 on success, 0 on failure
+ */
+int replaceFile(const char *from, const char *to)
+{
+#ifdef _WIN32
+    for (int attempt = 0; attempt < 50; attempt++)
+    {
+        if (MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+            return 1;
+        DWORD error = GetLastError();
+        if (error != ERROR_ACCESS_DENIED && error != ERROR_SHARING_VIOLATION)
+            return 0;
+        Sleep(2);  // A reader still has the old file open
+    }
+    return 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+/**
+ * Gives an existing file a second name
+ *
+ * @param existing Current name
+ * @param name New name (must not exist)
+ * @return 1 on success, 0 on failure
+ */
+int linkFile(const char *existing, const char *name)
+{
+#ifdef _WIN32
+    return CreateHardLinkA(name, existing, NULL) != 0;
+#else
+    return link(existing, name) == 0;
+#endif
+}
+
+/**
+ * Opens a lock file and locks it
+ *
+ * @param path Lock file (created if missing)
+ * @param wait 1 = wait while another process holds it, 0 = fail at once
+ * @param lock Receives the locked file
+ * @return 1 on success, 0 on failure (or, without wait, if it is held)
+ */
+int acquireFileLock(const char *path, int wait, FileLock *lock)
+{
+#ifdef _WIN32
+    OVERLAPPED whole = {0};
+    *lock = CreateFileA(path, GENERIC_READ | GENERIC_WRITE,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (*lock == INVALID_HANDLE_VALUE)
+        return 0;
+    if (LockFileEx(*lock, LOCKFILE_EXCLUSIVE_LOCK | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY),
+                   0, MAXDWORD, MAXDWORD, &whole))
+        return 1;
+    CloseHandle(*lock);
+    return 0;
+#else
+    *lock = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (*lock < 0)
+        return 0;
+    while (flock(*lock, wait ? LOCK_EX : LOCK_EX | LOCK_NB) != 0)
+    {
+        if (errno != EINTR)
+        {
+            close(*lock);
+            return 0;
+        }
+    }
+    return 1;
+#endif
+}
+
+/**
+ * Unlocks and closes a lock file
+ *
+ * @param lock File locked by acquireFileLock()
+ */
+void releaseFileLock(FileLock lock)
+{
+#ifdef _WIN32
+    OVERLAPPED whole = {0};
+    UnlockFileEx(lock, 0, MAXDWORD, MAXDWORD, &whole);
+    CloseHandle(lock);
+#else
+    close(lock);  // Drops the flock
+#endif
+}
+
+/**
+ * Reads the start of a file locked by acquireFileLock()
+ *
+ * On Windows the lock keeps other handles out, so the contents of a
+ * lock file are read and written through the locked handle itself.
+ *
+ * @param lock Locked file
+ * @param buffer Receives the bytes read
+ * @param size Size of buffer
+ * @return Bytes read, 0 on failure
+ */
+size_t readFileLock(FileLock lock, char *buffer, size_t size)
+{
+#ifdef _WIN32
+    OVERLAPPED at = {0};
+    DWORD read = 0;
+    return ReadFile(lock, buffer, (DWORD)size, &read, &at) ? read : 0;
+#else
+    ssize_t read = pread(lock, buffer, size, 0);
+    return read > 0 ? (size_t)read : 0;
+#endif
+}
+
+/**
+ * Writes the start of a file locked by acquireFileLock()
+ *
+ * @param lock Locked file
+ * @param data Bytes to write at offset 0
+ * @param len Number of bytes
+ * @return 1 on success, 0 on failure
+ */
+int writeFileLock(FileLock lock, const char *data, size_t len)
+{
+#ifdef _WIN32
+    OVERLAPPED at = {0};
+    DWORD written = 0;
+    return WriteFile(lock, data, (DWORD)len, &written, &at) && written == len;
+#else
+    return pwrite(lock, data, len, 0) == (ssize_t)len;
+#endif
+}
+
+/**
+ * Cuts an open file down to a size
+ *
+ * @param file File opened for writing (flushed first)
+ * @param size New size in bytes
+ * @return 1 on success, 0 on failure
+ */
+int truncateFile(FILE *file, long size)
+{
+    if (fflush(file) != 0)
+        return 0;
+#ifdef _WIN32
+    return _chsize(_fileno(file), size) == 0;
+#else
+    return ftruncate(fileno(file), size) == 0;
+#endif
+}
+
+/**
+ * Creates a directory, and any missing parents, if it does not exist yet
+ *
+ * @param path Directory path
+ * @return 1 if the directory exists afterwards, 0 otherwise
+ */
+int makeDirectory(const char *path)
+{
+    char partial[DATA_PATH_MAX];
+    snprintf(partial, sizeof(partial), "%s", path);
+    for (char *p = partial + 1; ; p++)
+    {
+        if (*p != '/' && *p != '\\' && *p != '\0')
+            continue;
+        char separator = *p;
+        *p = '\0';
+#ifdef _WIN32
+        _mkdir(partial);
+#else
+        mkdir(partial, 0777);
+#endif
+        *p = separator;
+        if (separator == '\0')
+            break;
+    }
+
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+/**
+ * Suspends the calling thread
+ *
+ * @param ms Milliseconds to sleep
+ */
+void sleepMs(unsigned ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+/**
+ * Returns a monotonic clock reading in milliseconds
+ *
+ * @return Milliseconds since an arbitrary fixed point
+ */
+unsigned long long tickCountMs()
+{
+#ifdef _WIN32
+    return GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000ULL + now.tv_nsec / 1000000;
+#endif
+}
+
+/**
+ * Returns a monotonic clock reading in microseconds
+ *
+ * @return Microseconds since an arbitrary fixed point
+ */
+unsigned long long tickCountUs()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (unsigned long long)(now.QuadPart / frequency.QuadPart * 1000000ULL +
+                                now.QuadPart % frequency.QuadPart * 1000000ULL / frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * Adds to a counter shared between threads
+ *
+ * @param target Counter to update
+ * @param amount Amount to add
+ */
+void atomicAdd(volatile long long *target, long long amount)
+{
+#ifdef _WIN32
+    InterlockedExchangeAdd64((volatile LONG64 *)target, amount);
+#else
+    __atomic_fetch_add(target, amount, __ATOMIC_RELAXED);
+#endif
+}
+
+/**
+ * Structure to store complete information about a car parking record
+ * Used for maintaining the parking history and generating receipts
+ */
+typedef struct
+{
+    char name[50];      // Owner's name
+    char plate[20];     // License plate number
+    char phone[15];     // Contact phone number
+    char address[100];  // Owner's address
+    int spot;           // Assigned parking spot number
+    time_t entry_time;  // Time when car entered the parking
+    time_t exit_time;   // Time when car exited (0 if still parked)
+    double fee;         // Calculated parking fee
+} CarRecord;
+
+/**
+ * Current status of all parking spots, one array per field
+ * Spot n is bay n - 1. Counting and free-bay scans only touch the
+ * occupancy bits; plates are only read for occupied bays.
+ */
+typedef struct
+{
+    int count;              // Number of bays
+    uint64_t *occupied;     // Occupancy bitset, bit (n - 1) for spot n
+    int64_t *entryTimes;    // Entry time of the car in each bay (0 if empty)
+    char (*plates)[20];     // License plate of the car in each bay ("EMPTY" if empty)
+} SpotTable;
+
+#define SPOT_WORDS(count) (((count) + 63) / 64)  // Bitset words for a number of bays
+
+/**
+ * Kinds of events handled by the group commit writer
+ */
+typedef enum
+{
+    JOURNAL_ENTRY,      // Car parked: occupy spot and append an open history row
+    JOURNAL_EXIT        // Car left: free spot and close its open history row
+} JournalEventType;
+
+/**
+ * Result of committing a journal event
+ */
+typedef enum
+{
+    COMMIT_OK,          // Event is on disk
+    COMMIT_CONFLICT,    // Spot taken / car no longer parked (another gate won)
+    COMMIT_IO_ERROR     // Data files could not be written
+} CommitStatus;
+
+/**
+ * A single spot/history change queued for the group commit writer
+ * The submitting gate blocks until the writer marks it durable
+ */
+typedef struct JournalEvent
+{
+    JournalEventType type;      // Entry or exit
+    CarRecord record;           // Entry: full record; exit: plate, spot, exit_time, fee
+    CommitStatus status;        // Outcome, valid once durable is set
+    int durable;                // Set by the writer after the batch is synced
+    struct JournalEvent *next;  // Next event in the pending queue
+} JournalEvent;
+
+/**
+ * Background writer that batches the journal events of one process
+ * and writes each batch with a single sync per data file
+ *
+ * Batches form from the threads of this process; separate processes
+ * (gates, CLI calls) each write their own and take turns on FILENAME_LOCK.
+ */
+typedef struct
+{
+    Mutex lock;                     // Protects the queue and durable flags
+    CondVar pending;                // Signalled when events are queued
+    CondVar committed;              // Signalled when a batch becomes durable
+    JournalEvent *head;             // Oldest queued event
+    JournalEvent *tail;             // Newest queued event
+    int queued;                     // Number of queued events
+    int started;                    // Writer thread running
+} GroupCommitWriter;
+
+/**
+ * Outcome of a park / leave operation
+ * Shared by the interactive screens and the command-line interface
+ */
+typedef enum
+{
+    OP_OK,              // Operation committed
+    OP_EMPTY_NAME,      // Owner name missing
+    OP_EMPTY_PLATE,     // License plate missing
+    OP_INVALID_PHONE,   // Phone is not 10 digits
+    OP_EMPTY_ADDRESS,   // Address missing
+    OP_INVALID_SPOT,    // No such spot, or spot occupied
+    OP_ALREADY_PARKED,  // Plate is already parked
+    OP_NOT_PARKED,      // Plate is not parked
+    OP_RESERVED,        // Spot is booked for someone else
+    OP_NO_VACANCY,      // No free spot to allocate
+    OP_INVALID_TIME,    // Booking window is empty or in the past
+    OP_NO_RESERVATION,  // No such booking
+    OP_IO_ERROR         // Data files could not be read or written
+} OpStatus;
+
+#define SEARCH_MAX_MATCHES 10  // Distinct plates/owners listed per search
+
+/**
+ * Which history field a search matches on
+ */
+typedef enum
+{
+    SEARCH_BY_NAME,     // Match owner name, collect plates
+    SEARCH_BY_PLATE     // Match plate, collect owner names
+} SearchField;
+
+/**
+ * Summary of the history rows matching a search
+ */
+typedef struct
+{
+    int totalEntries;                       // Number of matching rows
+    int count;                              // Distinct values collected
+    char matches[SEARCH_MAX_MATCHES][50];   // Plates (by name) or owners (by plate)
+} SearchResult;
+
+#define SEARCH_CACHE_SIZE 64  // Search results kept in memory
+
+/**
+ * One cached search result
+ */
+typedef struct
+{
+    int used;                   // Slot holds a result
+    SearchField field;          // Search kind
+    char key[50];               // Name or plate searched (compared case-insensitively)
+    SearchResult result;        // Result as of SearchCache.historySize
+    unsigned long long lastUsed; // LRU stamp
+} SearchCacheEntry;
+
+/**
+ * Bounded LRU cache of history searches
+ *
+ * Every entry is exact for the history file at historySize bytes after
+ * write number writes (HistoryMarker.writes). Entries written by this
+ * process update matching results in place; any other write, even one
+ * that keeps the file size, empties the cache.
+ */
+typedef struct
+{
+    Mutex lock;                 // Held by the writer for a whole batch
+    long historySize;           // File size all entries match, -1 if unknown
+    unsigned long writes;       // History writes all entries include
+    unsigned long long clock;   // LRU counter
+    SearchCacheEntry entries[SEARCH_CACHE_SIZE];
+} SearchCache;
+
+#define COLUMN_MAGIC "CPCOLS2\n"   // First 8 bytes of the column store
+#define COLUMN_HEADER_SIZE 48      // Magic, row count, first entry, last exit, history size and writes
+#define COLUMN_GROUP_ROWS 4096     // Rows encoded (and decoded) together
+#define DWELL_MAX_MINUTES 10080    // Dwell histogram resolution limit (one week)
+
+/**
+ * Growable byte buffer used while encoding columns
+ */
+typedef struct
+{
+    unsigned char *data;    // Bytes written so far
+    size_t len;             // Used length
+    size_t cap;             // Allocated length
+} ByteBuffer;
+
+/**
+ * Columns of the history store, in on-disk order
+ */
+typedef enum
+{
+    COL_ENTRY,          // Entry time, zigzag delta from the previous row
+    COL_DWELL,          // Exit time minus entry time, in seconds
+    COL_SPOT,           // Spot number
+    COL_FEE,            // Fee in paise
+    COL_OWNER,          // Owner id from the owner dictionary
+    COLUMN_COUNT
+} ColumnId;
+
+/**
+ * One closed history session, as exported to the column store
+ */
+typedef struct
+{
+    int64_t entry_time;
+    int64_t dwell;
+    int64_t spot;
+    int64_t fee;
+    int64_t owner;
+} ColumnRow;
+
+/**
+ * Summary stored at the start of the column store
+ */
+typedef struct
+{
+    uint64_t rows;          // Closed sessions exported
+    int64_t minTime;        // Earliest entry time
+    int64_t maxTime;        // Latest exit time
+    int64_t historySize;    // History file size it was exported from
+    uint64_t historyWrites; // HistoryMarker.writes it was exported after
+    int owners;             // Distinct owners (export only)
+} ColumnStoreHeader;
+
+/**
+ * Case-insensitive name -> owner id table built during export
+ */
+typedef struct
+{
+    char **names;           // Names by id
+    uint32_t *hashes;       // Name hashes by id
+    int count;              // Ids handed out
+    int capacity;           // Allocated names/hashes
+    int *slots;             // Open-addressing table of ids, -1 = empty
+    int slotCount;          // Table size (power of two)
+} OwnerDictionary;
+
+/**
+ * One decoded row group; only the requested columns are filled in
+ */
+typedef struct
+{
+    int rows;
+    int64_t entry[COLUMN_GROUP_ROWS];
+    int64_t dwell[COLUMN_GROUP_ROWS];
+    int64_t spot[COLUMN_GROUP_ROWS];
+    int64_t fee[COLUMN_GROUP_ROWS];
+    int64_t owner[COLUMN_GROUP_ROWS];
+    ByteBuffer scratch;     // Encoded bytes of the group
+} ColumnGroup;
+
+/**
+ * Reports available from the column store
+ */
+typedef enum
+{
+    REPORT_DAILY,       // Revenue per local day of exit
+    REPORT_HOURLY,      // Revenue per hour of day of exit
+    REPORT_LEVEL,       // Revenue per parking level
+    REPORT_DWELL,       // Dwell-time distribution (per minute)
+    REPORT_TURNOVER     // Sessions per bay
+} ReportKind;
+
+/**
+ * Aggregates produced by runReport(), indexed by report key
+ */
+typedef struct
+{
+    int keys;               // Length of the arrays below
+    long firstDay;          // Local day number of key 0 (daily report)
+    long utcOffset;         // Local time offset used for days and hours
+    int64_t *sessions;      // Sessions per key
+    int64_t *revenue;       // Fees in paise per key
+    int64_t *seconds;       // Total dwell seconds per key
+    int64_t totalSessions;
+    int64_t totalRevenue;
+    int64_t totalSeconds;
+} ReportTotals;
+
+#define STATEMENT_DEFAULT_MEMORY_MB 64  // Record memory for the statement sort
+#define STATEMENT_MAX_FANIN 64          // Runs merged at once
+
+/**
+ * Buffered reader over one sorted run file
+ */
+typedef struct
+{
+    FILE *file;             // Run file
+    CarRecord *buffer;      // Slice of the merge memory
+    int capacity;           // Records that fit in buffer
+    int count;              // Records currently in buffer
+    int pos;                // Next record in buffer
+} RunReader;
+
+/**
+ * Counters reported by generateStatements()
+ */
+typedef struct
+{
+    int owners;             // Statements written
+    long long sessions;     // History rows listed
+    int runs;               // Sorted runs spilled to disk
+    int passes;             // Merge passes over the runs
+} StatementStats;
+
+/**
+ * State of the statement being streamed out
+ */
+typedef struct
+{
+    FILE *file;             // Statements file being written
+    StatementStats *stats;  // Totals for the whole run
+    int hasOwner;           // A statement is open
+    char owner[50];         // Owner of the open statement
+    int ownerSessions;      // Rows in the open statement
+    double ownerTotal;      // Fees in the open statement
+} StatementWriter;
+
+#define IMPORT_CHUNK_BYTES (8 * 1024 * 1024)  // Input bytes parsed per worker per round
+#define IMPORT_MAX_THREADS 64                 // Upper limit for --threads (default: one per CPU)
+#define IMPORT_MAX_ERRORS 10                  // Rejected lines listed in the summary
+
+/**
+ * Why an imported row was rejected, with the line it was on
+ */
+typedef struct
+{
+    long long line;         // 1-based line number in the input
+    const char *code;       // Error code, as in the command output
+} ImportError;
+
+/**
+ * Row counts of an import
+ */
+typedef struct
+{
+    long long rows;                     // Data rows read
+    long long imported;                 // Rows appended to the history
+    long long duplicates;               // Rows already in the history or earlier in the input
+    long long malformed;                // Wrong field count, bad number or field too long
+    long long invalidTime;              // Open session, or exit before entry
+    long long rejected[OP_IO_ERROR];    // Failed addCar() validation, by OpStatus
+    int errorCount;
+    ImportError errors[IMPORT_MAX_ERRORS];  // First rejected lines
+} ImportStats;
+
+/**
+ * One input chunk handed to a parser thread
+ *
+ * The worker validates each line and writes accepted rows in history
+ * format to out, with their offsets and dedupe fingerprints.
+ */
+typedef struct
+{
+    char *input;            // Whole lines of input
+    size_t inputLen;
+    long long firstLine;    // Line number of the first line in input
+    int skipHeader;         // First line may be a header row
+    ByteBuffer out;         // Accepted rows, history format
+    size_t *rowStart;       // Offset of each accepted row in out
+    uint64_t *fingerprint;  // Plate/entry-time fingerprint of each row
+    int rowCount;
+    int rowCapacity;
+    int failed;             // Ran out of memory part way through
+    ImportStats stats;      // Counts for this chunk only
+} ImportChunk;
+
+/**
+ * Set of 64-bit fingerprints (open addressing, 0 = empty)
+ */
+typedef struct
+{
+    uint64_t *slots;
+    size_t slotCount;       // Power of two
+    size_t count;
+} FingerprintSet;
+
+/**
+ * Result of a retention compaction
+ */
+typedef struct
+{
+    long long scanned;      // History rows read
+    long long anonymized;   // Expired rows with personal data replaced
+    long long deleted;      // Expired rows removed
+    long bytesBefore;       // History size before
+    long bytesAfter;        // History size after
+} RetentionStats;
+
+/**
+ * Where a row copied by a compaction came from and went, so a partly
+ * stale copy can be cut back to its last exact checkpoint
+ */
+typedef struct
+{
+    long fileOffset;        // Row start in the history file
+    size_t outOffset;       // Row start in the compacted file
+    long long scanned;      // RetentionStats counts before this row
+    long long anonymized;
+    long long deleted;
+} CopyMark;
+
+/**
+ * A booked time window on one bay
+ */
+typedef struct
+{
+    int id;             // Booking number
+    char plate[20];     // Car the bay is held for
+    time_t start;       // First second of the window
+    time_t end;         // First second after the window
+} Reservation;
+
+/**
+ * Bookings of one bay, sorted by start time and never overlapping,
+ * so their end times are sorted too and can be binary searched
+ */
+typedef struct
+{
+    Reservation *items;
+    int count;
+    int capacity;
+} BayReservations;
+
+/**
+ * All current and future bookings, kept current by refreshReservations()
+ */
+typedef struct
+{
+    Mutex lock;                             // Held while the book is read or changed
+    BayReservations *bays;                  // Bookings by spot number - 1, allocated with the first one
+    int bayCount;                           // Bays in bays, 0 before the first booking
+    int count;                              // Bookings in all bays
+    int nextId;                             // Number for the next booking
+    long fileOffset;                        // Reservation file bytes already loaded
+} ReservationBook;
+
+#define PLATE_MAX_CANDIDATES 5   // Suggestions returned by a plate lookup
+#define PLATE_EDIT_COST 10       // Cost of an inserted, dropped or misread character
+#define PLATE_CONFUSABLE_COST 3  // Cost of a look-alike misread (O/0, I/1, B/8, S/5, Z/2)
+#define PLATE_MAX_COST 13        // Largest total cost still suggested (one edit plus one look-alike)
+#define PLATE_PREFIX_COST 4      // Base cost of a plate that merely starts with the query
+#define PLATE_INDEX_MARK_ROWS 4096  // History rows between remembered row offsets
+
+/**
+ * Trie node over normalized plate characters (first-child/next-sibling)
+ */
+typedef struct
+{
+    char symbol;        // Character on the edge into this node
+    int firstChild;     // First child node, -1 if none
+    int nextSibling;    // Next child of the same parent, -1 if none
+    int plate;          // Plate ending here, -1 if none
+} PlateTrieNode;
+
+/**
+ * A plate known to the index
+ */
+typedef struct
+{
+    char plate[20];     // Plate as last written (for display and leaveCar)
+    int spot;           // Spot it is parked in, 0 if not parked
+    int visits;         // History rows seen for it
+} PlateEntry;
+
+/**
+ * Lookup structure over parked and historical plates
+ * Kept current by refreshPlateIndex() from the spots and history files
+ */
+typedef struct
+{
+    PlateTrieNode *nodes;   // Node 0 is the root
+    int nodeCount;
+    int nodeCapacity;
+    PlateEntry *plates;
+    int plateCount;
+    int plateCapacity;
+    int *parked;            // Plate ids currently parked
+    int parkedCount;
+    int parkedCapacity;
+    long historyOffset;     // History bytes already indexed
+    long historyRows;       // History rows already indexed
+    long *marks;            // Offset of row n * PLATE_INDEX_MARK_ROWS, at n
+    int markCount;
+    int markCapacity;
+    unsigned long generation;   // HistoryMarker.generation the offset belongs to
+    unsigned long writes;       // HistoryMarker.writes already seen
+} PlateIndex;
+
+/**
+ * One suggested plate
+ */
+typedef struct
+{
+    char plate[20];     // Plate as written
+    int spot;           // Spot if parked, 0 otherwise
+    int visits;         // History rows seen for it
+    int cost;           // Match cost, 0 = exact
+    int prefix;         // Matched as a prefix rather than by edit distance
+} PlateMatch;
+
+/**
+ * Ranked plate suggestions, best first
+ */
+typedef struct
+{
+    int count;
+    PlateMatch matches[PLATE_MAX_CANDIDATES];
+} PlateCandidates;
+
+/**
+ * A piece of work run on a facility's worker thread
+ */
+typedef struct FacilityTask
+{
+    void (*run)(void *context);     // Called with currentFacility set to the facility
+    void *context;                  // Argument and result of run
+    int done;                       // Set by the worker once run has returned
+    struct FacilityTask *next;      // Next queued task
+} FacilityTask;
+
+/**
+ * History changes made by any process, kept in the facility's lock file
+ *
+ * Read and written only with the lock file held. Every write to the
+ * history bumps writes and records the lowest offset it changed, so a
+ * reader can tell which part of what it read earlier is out of date.
+ */
+typedef struct
+{
+    unsigned long writes;       // History writes so far
+    unsigned long generation;   // Bumped whenever the history file is replaced
+    long compactFrom;           // Lowest offset written since compaction last reset it
+    long changedFrom[HISTORY_MARKER_SLOTS];  // Lowest offset of write n, at n % HISTORY_MARKER_SLOTS
+} HistoryMarker;
+
+/**
+ * One car park: its data directory and everything derived from it
+ * Facilities share nothing, so each can be served by its own thread
+ */
+typedef struct
+{
+    char id[32];                    // Name used on the command line
+    char directory[200];            // Data files live here ("" = working directory)
+    GroupCommitWriter journalWriter;    // Batches this site's spot/history writes
+    SearchCache searchCache;        // Its lock is also held for every history write
+    FileLock writeLock;             // FILENAME_LOCK, held between beginHistoryWrite() and endHistoryWrite()
+    int writeLocked;                // writeLock is held
+    HistoryMarker marker;           // As last read from the lock file (current while writeLocked)
+    PlateIndex plateIndex;          // Refreshed before each lookup
+    ReservationBook reservations;   // Refreshed before each entry or booking
+    Mutex taskLock;                 // Protects the task queue
+    CondVar taskPending;            // Signalled when a task is queued
+    CondVar taskDone;               // Signalled when a task has run
+    FacilityTask *taskHead;         // Oldest queued task
+    FacilityTask *taskTail;         // Newest queued task
+    int workerStarted;              // Worker thread running
+} Facility;
+
+/**
+ * Where a plate is parked at one facility (answer of a fan-out query)
+ */
+typedef struct
+{
+    const char *plate;              // Plate asked for
+    int spot;                       // Spot it is parked in, 0 if not here
+    char parkedPlate[20];           // Plate as stored at entry
+    time_t entryTime;               // Entry time if parked
+    PlateCandidates similar;        // Parked plates close to it
+    int ok;                         // Spots file could be read
+} PlateWhereabouts;
+
+/**
+ * Occupancy of one facility (answer of a fan-out query)
+ */
+typedef struct
+{
+    int occupied;                   // Cars parked
+    int held;                       // Free bays held for a booking
+    int ok;                         // Spots file could be read
+} FacilityOccupancy;
+
+/**
+ * Distribution of simulated stays
+ */
+typedef enum
+{
+    DWELL_EXPONENTIAL,  // Memoryless: many short stays, a long tail
+    DWELL_LOGNORMAL,    // Typical car park shape: a peak with a long right tail
+    DWELL_FIXED         // Every car stays exactly the mean
+} DwellDistribution;
+
+/**
+ * Parameters of a simulation run
+ */
+typedef struct
+{
+    unsigned long long seed;        // Same seed, same arrivals and stays
+    double rate;                    // Mean arrivals per hour
+    int hours;                      // Simulated time
+    double dwellMinutes;            // Mean stay
+    DwellDistribution dwell;
+    int rushHour;                   // 1 = weekday commuter profile, 0 = flat
+} SimConfig;
+
+/**
+ * A simulated car waiting to leave
+ */
+typedef struct
+{
+    time_t time;                    // Virtual departure time
+    int car;                        // Car number (plate SIMnnnnnnn)
+} SimDeparture;
+
+/**
+ * Results of a simulation run
+ */
+typedef struct
+{
+    long long arrivals;             // Cars that turned up
+    long long parked;               // Cars given a bay
+    long long turnedAway;           // Cars that found no free bay
+    long long departures;           // Cars that left (before the end of the run)
+    long long failures;             // Operations that failed for any other reason
+    int peakOccupancy;              // Most bays in use at once
+    double meanOccupancy;           // Time-weighted bays in use
+    double revenue;                 // Fees of cars that left
+    unsigned long long wallUs;      // Real time taken
+    unsigned long long checksum;    // Hash of every outcome, for regression runs
+    unsigned *parkUs;               // Latency of each park, sorted at the end
+    unsigned *leaveUs;              // Latency of each leave, sorted at the end
+} SimStats;
+
+/**
+ * An open history row (exit_time == 0) found by the consistency check
+ */
+typedef struct
+{
+    long offset;            // Row start in the history file
+    char plate[20];
+    int spot;
+    int64_t entryTime;
+    int lineEnd;            // Length of the line break ("\n" or "\r\n")
+} OpenSession;
+
+/**
+ * One slice of the history handed to a scan thread
+ */
+typedef struct
+{
+    long start;             // First byte of the slice; rows starting here or later
+    long end;               // ...and before this offset belong to the slice
+    OpenSession *rows;      // Open rows found, in file order
+    int count;
+    int capacity;
+    long long scanned;      // Rows read
+    int failed;             // Could not read the file or ran out of memory
+} VerifyChunk;
+
+/**
+ * A bay and an open history row that do not agree
+ */
+typedef struct
+{
+    const char *code;       // no_open_row, bay_empty, bay_taken or duplicate
+    int spot;
+    char plate[20];
+    int64_t entryTime;
+} Discrepancy;
+
+/**
+ * Result of a consistency check
+ */
+typedef struct
+{
+    long long scanned;      // History rows read
+    int threads;            // Scan threads used
+    int openRows;           // Rows with exit_time == 0
+    int occupied;           // Occupied bays
+    int missingRows;        // Occupied bays without an open row
+    int staleRows;          // Open rows without a matching occupied bay
+    int repaired;           // Rows appended or closed by the repair
+    int listed;
+    Discrepancy list[VERIFY_MAX_LISTED];  // First discrepancies found
+    unsigned long long wallUs;  // Time taken
+} VerifyStats;
+
+/**
+ * Event counters kept by the metrics layer
+ */
+typedef enum
+{
+    METRIC_FILE_OPENS,          // Data files opened
+    METRIC_BYTES_READ,          // Bytes parsed from data files
+    METRIC_BYTES_WRITTEN,       // Bytes written to data files
+    METRIC_RECORDS_SCANNED,     // Spot and history rows parsed
+    METRIC_FILE_SYNCS,          // Flushes to disk
+    METRIC_COMMIT_BATCHES,      // Group commit batches written
+    METRIC_COMMIT_EVENTS,       // Journal events in those batches
+    METRIC_SEARCH_CACHE_HITS,   // Searches answered from the cache
+    METRIC_SEARCH_CACHE_MISSES, // Searches that scanned the history file
+    METRIC_ROWS_EXPIRED,        // History rows anonymized or deleted by retention
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+/**
+ * Operations timed by the metrics layer
+ */
+typedef enum
+{
+    METRIC_PARK,                // parkCar()
+    METRIC_LEAVE,               // leaveCar()
+    METRIC_SEARCH,              // scanHistory()
+    METRIC_PLATE_LOOKUP,        // lookupPlates()
+    METRIC_INDEX_REFRESH,       // refreshPlateIndex()
+    METRIC_LOCK_WAIT,           // Acquiring the group commit lock
+    METRIC_COMMIT_WAIT,         // Queued journal event until durable
+    METRIC_BATCH_WRITE,         // Writing one group commit batch
+    METRIC_FILE_SYNC,           // syncFile()
+    METRIC_COMPACTION_LOCK,     // History lock held by the retention swap
+    METRIC_HISTOGRAM_COUNT
+} MetricHistogram;
+
+/**
+ * Current-value gauges kept by the metrics layer
+ */
+typedef enum
+{
+    METRIC_SPOTS_OCCUPIED,      // Occupied spots, as last read or written
+    METRIC_COMMIT_QUEUE_DEPTH,  // Journal events waiting for the writer
+    METRIC_PLATES_INDEXED,      // Plates in the plate lookup index
+    METRIC_GAUGE_COUNT
+} MetricGauge;
+
+#define METRIC_BUCKETS 24  // Latency buckets: < 1us, < 2us, < 4us, ... < 4.2s, +Inf
+
+/**
+ * Process-wide counters and log2 latency histograms
+ * Updated with atomic adds, so any thread may record without locking
+ */
+typedef struct
+{
+    int enabled;                                                    // Record at run time
+    volatile long long counters[METRIC_COUNTER_COUNT];
+    volatile long long buckets[METRIC_HISTOGRAM_COUNT][METRIC_BUCKETS];
+    volatile long long totalUs[METRIC_HISTOGRAM_COUNT];             // Sum of observed latencies
+    volatile int gauges[METRIC_GAUGE_COUNT];
+    unsigned long long nextExport;                                  // tickCountMs() of next file export
+} Metrics;
+
+#if METRICS_ENABLED
+#define METRIC_ADD(counter, amount) \
+    do { if (metrics.enabled) atomicAdd(&metrics.counters[counter], (amount)); } while (0)
+#define METRIC_START(name) unsigned long long name = metrics.enabled ? tickCountUs() : 0
+#define METRIC_OBSERVE(histogram, start) \
+    do { if (metrics.enabled) observeLatency(histogram, tickCountUs() - (start)); } while (0)
+#else
+#define METRIC_ADD(counter, amount) ((void)0)
+#define METRIC_START(name) ((void)0)
+#define METRIC_OBSERVE(histogram, start) ((void)0)
+#endif
+
+/**
+ * One character cell of the off-screen console buffer
+ */
+typedef struct
+{
+    unsigned char ch;    // Character (code page 437)
+    unsigned char attr;  // Windows console color attribute
+} ScreenCell;
+
+#define CELL_UNKNOWN 0xFF  // Attribute marking a front cell whose on-screen content is unknown
+
+/**
+ * Double-buffered console
+ * Screens draw into the back buffer; presentScreen() compares it with
+ * the front buffer (what the terminal shows) and writes only the changes
+ */
+typedef struct
+{
+    ScreenCell back[SCREEN_HEIGHT][SCREEN_WIDTH];   // Frame being drawn
+    ScreenCell front[SCREEN_HEIGHT][SCREEN_WIDTH];  // Frame currently on screen
+    int cursorX;         // Drawing / input cursor column
+    int cursorY;         // Drawing / input cursor row
+    unsigned char attr;  // Current drawing attribute
+} ScreenBuffer;
+
+// Global console buffer used by all screens
+ScreenBuffer screen;
+
+// Facility used when none is chosen: the working directory
+Facility defaultFacility;
+
+// Facility the calling thread works on; data files and per-site state are reached through it
+THREAD_LOCAL Facility *currentFacility = &defaultFacility;
+
+// Facilities listed in the facilities file
+Facility *facilities[MAX_FACILITIES];
+int facilityCount;
+
+// Global metrics, recorded unless disabled at compile or run time
+Metrics metrics = {.enabled = METRICS_ENABLED};
+
+/**
+ * Change notification on the data files, used by the live screens
+ */
+typedef struct
+{
+    int opened;     // Watch set up (or attempted)
+#ifdef _WIN32
+    HANDLE handle;  // Event signalled by a directory change, INVALID_HANDLE_VALUE if unavailable
+    HANDLE directory;   // Data directory opened for change reads
+    OVERLAPPED overlapped;  // Pending ReadDirectoryChangesW()
+    DWORD events[1024];     // FILE_NOTIFY_INFORMATION records (DWORD aligned)
+#else
+    int fd;         // inotify descriptor, -1 if unavailable
+#endif
+} DataWatch;
+
+// Global watch on the working directory holding the data files
+DataWatch dataWatch;
+
+/**
+ * Message drawn over the current screen until its timer runs out
+ */
+typedef struct
+{
+    int active;                     // Message is on screen
+    int x, y, len;                  // Screen cells it occupies
+    unsigned long long expiresAt;   // tickCountMs() deadline for erasing it
+} FlashMessage;
+
+/**
+ * Message carried over to the next menu screen
+ */
+typedef struct
+{
+    char text[64];      // Message, empty if none
+    int color;          // Color code to show it in
+} Notice;
+
+// Global UI timer state
+FlashMessage flash;
+Notice notice;
+
+#ifndef _WIN32
+// Terminal mode to restore on exit
+struct termios savedTerminal;
+int terminalIsRaw = 0;
+#endif
+
+/**
+ * Records one latency observation
+ *
+ * @param histogram Operation that was timed
+ * @param us Duration in microseconds
+ */
+void observeLatency(MetricHistogram histogram, unsigned long long us)
+{
+    int bucket = 0;
+    while (bucket < METRIC_BUCKETS - 1 && (us >> bucket) != 0)
+        bucket++;
+    atomicAdd(&metrics.buckets[histogram][bucket], 1);
+    atomicAdd(&metrics.totalUs[histogram], (long long)us);
+}
+
+/**
+ * Sets a gauge to its latest value
+ *
+ * @param gauge Gauge to set
+ * @param value Current value
+ */
+void setGauge(MetricGauge gauge, int value)
+{
+    if (metrics.enabled)
+        metrics.gauges[gauge] = value;
+}
+
+/**
+ * Builds the path of a data file of the current facility
+ *
+ * @param path Receives the path
+ * @param size Size of path
+ * @param name File name
+ */
+void dataPath(char *path, size_t size, const char *name)
+{
+    if (currentFacility->directory[0])
+        snprintf(path, size, "%s/%s", currentFacility->directory, name);
+    else
+        snprintf(path, size, "%s", name);
+}
+
+/**
+ * Opens a data file of the current facility, counting the open
+ *
+ * @param name File name
+ * @param mode fopen() mode
+ * @return Open file, or NULL
+ */
+FILE *openDataFile(const char *name, const char *mode)
+{
+    char path[DATA_PATH_MAX];
+    dataPath(path, sizeof(path), name);
+    METRIC_ADD(METRIC_FILE_OPENS, 1);
+    return fopen(path, mode);
+}
+
+/**
+ * Deletes a data file of the current facility
+ *
+ * @param name File name
+ */
+void removeDataFile(const char *name)
+{
+    char path[DATA_PATH_MAX];
+    dataPath(path, sizeof(path), name);
+    remove(path);
+}
+
+/**
+ * Replaces a data file of the current facility with another one
+ *
+ * @param from Newly written file name
+ * @param to File name to replace
+ * @return 1 on success, 0 on failure
+ */
+int replaceDataFile(const char *from, const char *to)
+{
+    char fromPath[DATA_PATH_MAX], toPath[DATA_PATH_MAX];
+    dataPath(fromPath, sizeof(fromPath), from);
+    dataPath(toPath, sizeof(toPath), to);
+    return replaceFile(fromPath, toPath);
+}
+
+/**
+ * Locks the facility's lock file and reads the history marker from it
+ *
+ * Call with the history lock (searchCache.lock) held; end with
+ * unlockHistoryFile() whatever the result.
+ *
+ * @return 1 if the lock file is locked, 0 if it could not be
+ */
+int lockHistoryFile()
+{
+    char path[DATA_PATH_MAX], text[(HISTORY_MARKER_SLOTS + 3) * 21 + 1];
+    HistoryMarker *marker = &currentFacility->marker;
+    dataPath(path, sizeof(path), FILENAME_LOCK);
+    currentFacility->writeLocked = acquireFileLock(path, 1, &currentFacility->writeLock);
+    if (!currentFacility->writeLocked)
+        return 0;
+
+    // A new (empty) lock file means no writes yet
+    size_t len = readFileLock(currentFacility->writeLock, text, sizeof(text) - 1);
+    text[len] = '\0';
+    int used = 0, fields = sscanf(text, "%lu %lu %ld%n", &marker->writes, &marker->generation,
+                                  &marker->compactFrom, &used);
+    for (int i = 0; i < HISTORY_MARKER_SLOTS && fields >= 3; i++)
+    {
+        int next = 0;
+        if (sscanf(text + used, "%ld%n", &marker->changedFrom[i], &next) == 1)
+            fields++;
+        used += next;
+    }
+    if (fields != HISTORY_MARKER_SLOTS + 3)
+    {
+        memset(marker, 0, sizeof(*marker));
+        marker->compactFrom = LONG_MAX;
+    }
+    return 1;
+}
+
+/**
+ * Unlocks the lock file locked by lockHistoryFile()
+ */
+void unlockHistoryFile()
+{
+    if (currentFacility->writeLocked)
+        releaseFileLock(currentFacility->writeLock);
+    currentFacility->writeLocked = 0;
+}
+
+/**
+ * Writes the history marker back to the lock file
+ *
+ * Every field has a fixed width, so the text never gets shorter and
+ * the file needs no truncating.
+ */
+void saveHistoryMarker()
+{
+    char text[(HISTORY_MARKER_SLOTS + 3) * 21 + 1];
+    const HistoryMarker *marker = &currentFacility->marker;
+    if (!currentFacility->writeLocked)
+        return;
+    int len = sprintf(text, "%20lu %20lu %20ld", marker->writes, marker->generation, marker->compactFrom);
+    for (int i = 0; i < HISTORY_MARKER_SLOTS; i++)
+        len += sprintf(text + len, " %20ld", marker->changedFrom[i]);
+    text[len++] = '\n';
+    writeFileLock(currentFacility->writeLock, text, len);
+}
+
+/**
+ * Records a write to the history file in the history marker
+ *
+ * Call with the lock file held, after the write.
+ *
+ * @param changedFrom Lowest offset written, 0 if the whole file may have changed
+ */
+void noteHistoryWrite(long changedFrom)
+{
+    HistoryMarker *marker = &currentFacility->marker;
+    marker->writes++;
+    marker->changedFrom[marker->writes % HISTORY_MARKER_SLOTS] = changedFrom;
+    if (changedFrom < marker->compactFrom)
+        marker->compactFrom = changedFrom;
+    saveHistoryMarker();
+}
+
+/**
+ * Records that the history file was swapped for a rewritten one
+ *
+ * Byte offsets into the old file are meaningless afterwards.
+ */
+void noteHistoryReplaced()
+{
+    currentFacility->marker.generation++;
+    noteHistoryWrite(0);
+}
+
+/**
+ * Starts a write to the spots or history file of the current facility
+ *
+ * Takes the in-process history lock, then the facility's lock file, so
+ * that writers in other processes (other gates, CLI calls) take turns
+ * with this one. End with endHistoryWrite() whatever the result.
+ *
+ * @return 1 if both locks are held, 0 if the lock file could not be locked
+ */
+int beginHistoryWrite()
+{
+    mutexLock(&currentFacility->searchCache.lock);
+    return lockHistoryFile();
+}
+
+/**
+ * Ends a write started with beginHistoryWrite()
+ */
+void endHistoryWrite()
+{
+    unlockHistoryFile();
+    mutexUnlock(&currentFacility->searchCache.lock);
+}
+
+/**
+ * Writes all metrics in the Prometheus text exposition format
+ *
+ * @param out Destination
+ */
+void writeMetrics(FILE *out)
+{
+    static const char *counterNames[METRIC_COUNTER_COUNT] = {
+        "file_opens", "bytes_read", "bytes_written", "records_scanned",
+        "file_syncs", "commit_batches", "commit_events",
+        "search_cache_hits", "search_cache_misses", "rows_expired"};
+    static const char *histogramNames[METRIC_HISTOGRAM_COUNT] = {
+        "park", "leave", "search", "plate_lookup", "index_refresh",
+        "lock_wait", "commit_wait", "batch_write", "file_sync", "compaction_lock"};
+
+    for (int c = 0; c < METRIC_COUNTER_COUNT; c++)
+    {
+        fprintf(out, "# TYPE carpark_%s_total counter\n", counterNames[c]);
+        fprintf(out, "carpark_%s_total %lld\n", counterNames[c], metrics.counters[c]);
+    }
+
+    fprintf(out, "# TYPE carpark_operation_duration_seconds histogram\n");
+    for (int h = 0; h < METRIC_HISTOGRAM_COUNT; h++)
+    {
+        long long cumulative = 0;
+        for (int b = 0; b < METRIC_BUCKETS; b++)
+        {
+            cumulative += metrics.buckets[h][b];
+            if (b < METRIC_BUCKETS - 1)
+                fprintf(out, "carpark_operation_duration_seconds_bucket{op=\"%s\",le=\"%g\"} %lld\n",
+                        histogramNames[h], (double)(1ULL << b) / 1e6, cumulative);
+            else
+                fprintf(out, "carpark_operation_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %lld\n",
+                        histogramNames[h], cumulative);
+        }
+        fprintf(out, "carpark_operation_duration_seconds_sum{op=\"%s\"} %.6f\n",
+                histogramNames[h], metrics.totalUs[h] / 1e6);
+        fprintf(out, "carpark_operation_duration_seconds_count{op=\"%s\"} %lld\n",
+                histogramNames[h], cumulative);
+    }
+
+    static const char *gaugeNames[METRIC_GAUGE_COUNT] = {
+        "spots_occupied", "commit_queue_depth", "plates_indexed"};
+    fprintf(out, "# TYPE carpark_spots gauge\ncarpark_spots %d\n", PARKING_SPOTS);
+    for (int g = 0; g < METRIC_GAUGE_COUNT; g++)
+        fprintf(out, "# TYPE carpark_%s gauge\ncarpark_%s %d\n", gaugeNames[g], gaugeNames[g], metrics.gauges[g]);
+}
+
+/**
+ * Writes the metrics file into the current facility's directory,
+ * replacing the previous one in one step so a scraper never reads a
+ * half-written file
+ *
+ * @return 1 on success, 0 on failure
+ */
+int exportMetrics()
+{
+    FILE *file = openDataFile(FILENAME_METRICS ".tmp", "w");
+    if (file == NULL)
+        return 0;
+    writeMetrics(file);
+    int ok = fclose(file) == 0;
+    return ok && replaceDataFile(FILENAME_METRICS ".tmp", FILENAME_METRICS);
+}
+
+/**
+ * Exports the metrics file when its interval has passed
+ *
+ * @return Milliseconds until the next export is due (WAIT_FOREVER if disabled)
+ */
+unsigned exportMetricsIfDue()
+{
+    if (!metrics.enabled)
+        return WAIT_FOREVER;
+
+    unsigned long long now = tickCountMs();
+    if (now >= metrics.nextExport)
+    {
+        exportMetrics();
+        metrics.nextExport = now + METRICS_EXPORT_MS;
+    }
+    return (unsigned)(metrics.nextExport - now);
+}
+
+/**
+ * Positions the cursor at specified coordinates in the console
+ * 
+ * @param x X-coordinate (column)
+ * @param y Y-coordinate (row)
+ */
+void gotoxy(int x, int y)
+{
+    screen.cursorX = x;
+    screen.cursorY = y;
+}
+
+/**
+ * Sets the text color for console output
+ * 
+ * @param color Color code (Windows console color attribute)
+ *              Common values: 10=green, 11=cyan, 12=red, 15=white
+ */
+void setColor(int color)
+{
+    screen.attr = (unsigned char)color;
+}
+
+/**
+ * Writes one character at the cursor and advances it
+ *
+ * Characters outside the screen are clipped. A newline moves the
+ * cursor to the start of the next row, like the console does.
+ *
+ * @param ch Character to write (code page 437)
+ */
+void putCell(unsigned char ch)
+{
+    if (ch == '\n')
+    {
+        screen.cursorX = 0;
+        screen.cursorY++;
+        return;
+    }
+    if (screen.cursorX >= 0 && screen.cursorX < SCREEN_WIDTH &&
+        screen.cursorY >= 0 && screen.cursorY < SCREEN_HEIGHT)
+    {
+        screen.back[screen.cursorY][screen.cursorX].ch = ch;
+        screen.back[screen.cursorY][screen.cursorX].attr = screen.attr;
+    }
+    screen.cursorX++;
+}
+
+/**
+ * printf-style output into the console buffer at the cursor
+ *
+ * @param format printf format string
+ */
+void screenPrintf(const char *format, ...)
+{
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    for (const char *p = text; *p; p++)
+        putCell((unsigned char)*p);
+}
+
+/**
+ * Blanks the back buffer and homes the cursor (replaces system("cls"))
+ */
+void clearScreen()
+{
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        for (int x = 0; x < SCREEN_WIDTH; x++)
+        {
+            screen.back[y][x].ch = ' ';
+            screen.back[y][x].attr = 7;
+        }
+    }
+    screen.cursorX = 0;
+    screen.cursorY = 0;
+    flash.active = 0;  // Messages do not survive a screen change
+}
+
+/**
+ * Marks part of a row as unknown so the next present redraws it
+ * Used after the console itself echoed user input there
+ *
+ * @param x First column
+ * @param y Row
+ */
+void invalidateRow(int x, int y)
+{
+    if (y < 0 || y >= SCREEN_HEIGHT)
+        return;
+    for (; x < SCREEN_WIDTH; x++)
+    {
+        if (x >= 0)
+            screen.front[y][x].attr = CELL_UNKNOWN;
+    }
+}
+
+/**
+ * Compares a back buffer cell with what is on screen
+ * Blanks only differ when their background color differs
+ *
+ * @param x Column
+ * @param y Row
+ * @return 1 if the cell needs no redraw
+ */
+int cellUnchanged(int x, int y)
+{
+    ScreenCell *back = &screen.back[y][x], *front = &screen.front[y][x];
+    if (front->attr == CELL_UNKNOWN || back->ch != front->ch)
+        return 0;
+    if (back->ch == ' ')
+        return (back->attr & 0xF0) == (front->attr & 0xF0);
+    return back->attr == front->attr;
+}
+
+#ifdef _WIN32
+/**
+ * Writes the changed part of the frame with one WriteConsoleOutput call
+ *
+ * Only the bounding rectangle of changed cells is transferred.
+ */
+void presentScreen()
+{
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    int left = SCREEN_WIDTH, top = SCREEN_HEIGHT, right = -1, bottom = -1;
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        for (int x = 0; x < SCREEN_WIDTH; x++)
+        {
+            if (cellUnchanged(x, y))
+                continue;
+            if (x < left) left = x;
+            if (x > right) right = x;
+            if (y < top) top = y;
+            if (y > bottom) bottom = y;
+        }
+    }
+
+    if (right >= 0)
+    {
+        static CHAR_INFO cells[SCREEN_HEIGHT * SCREEN_WIDTH];
+        int width = right - left + 1;
+        int height = bottom - top + 1;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                ScreenCell *cell = &screen.back[top + y][left + x];
+                cells[y * width + x].Char.AsciiChar = (CHAR)cell->ch;
+                cells[y * width + x].Attributes = cell->attr;
+            }
+            memcpy(&screen.front[top + y][left], &screen.back[top + y][left],
+                   width * sizeof(ScreenCell));
+        }
+
+        COORD size = {(SHORT)width, (SHORT)height};
+        COORD origin = {0, 0};
+        SMALL_RECT region = {(SHORT)left, (SHORT)top, (SHORT)right, (SHORT)bottom};
+        WriteConsoleOutputA(console, cells, size, origin, &region);
+    }
+
+    // Input echoed by the console uses the current color at the cursor
+    COORD cursor = {(SHORT)screen.cursorX, (SHORT)screen.cursorY};
+    SetConsoleTextAttribute(console, screen.attr);
+    SetConsoleCursorPosition(console, cursor);
+}
+#else
+// Output buffer for one ANSI frame; flushed early only if a frame overflows it
+static char ansiOut[32768];
+static size_t ansiLen = 0;
+
+/**
+ * Appends bytes to the pending ANSI frame
+ *
+ * @param text Bytes to append
+ * @param len Number of bytes
+ */
+void ansiAppend(const char *text, size_t len)
+{
+    if (ansiLen + len > sizeof(ansiOut))
+    {
+        fwrite(ansiOut, 1, ansiLen, stdout);
+        ansiLen = 0;
+    }
+    memcpy(ansiOut + ansiLen, text, len);
+    ansiLen += len;
+}
+
+/**
+ * Appends the SGR sequence for a Windows console color attribute
+ *
+ * @param attr Attribute (low nibble foreground, high nibble background)
+ */
+void ansiColor(unsigned char attr)
+{
+    static const int ansiOrder[8] = {0, 4, 2, 6, 1, 5, 3, 7};  // BGR bits to ANSI color
+    char seq[24];
+    int fg = attr & 0x0F, bg = (attr >> 4) & 0x0F;
+    int len = snprintf(seq, sizeof(seq), "\x1b[0;%d;%dm",
+                       (fg & 8 ? 90 : 30) + ansiOrder[fg & 7],
+                       (bg & 8 ? 100 : 40) + ansiOrder[bg & 7]);
+    ansiAppend(seq, len);
+}
+
+/**
+ * Appends a cell character, translating code page 437 drawing
+ * characters to UTF-8
+ *
+ * @param ch Character (code page 437)
+ */
+void ansiGlyph(unsigned char ch)
+{
+    const char *glyph;
+    switch (ch)
+    {
+    case 177: glyph = "\xe2\x96\x92"; break;  // Shaded block
+    case 186: glyph = "\xe2\x95\x91"; break;  // Double vertical
+    case 187: glyph = "\xe2\x95\x97"; break;  // Double top-right
+    case 188: glyph = "\xe2\x95\x9d"; break;  // Double bottom-right
+    case 200: glyph = "\xe2\x95\x9a"; break;  // Double bottom-left
+    case 201: glyph = "\xe2\x95\x94"; break;  // Double top-left
+    case 205: glyph = "\xe2\x95\x90"; break;  // Double horizontal
+    default:
+    {
+        char plain = ch < 128 ? (char)ch : '?';
+        ansiAppend(&plain, 1);
+        return;
+    }
+    }
+    ansiAppend(glyph, strlen(glyph));
+}
+
+/**
+ * Writes the changed part of the frame as ANSI escape sequences
+ *
+ * Changed cells are grouped into runs per row; short unchanged gaps
+ * are rewritten rather than skipped with a cursor move. Each run costs
+ * one cursor move, colors are only emitted when they change, and the
+ * whole frame goes out in a single write.
+ */
+void presentScreen()
+{
+    int lastAttr = -1;
+    char seq[24];
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
+    {
+        int x = 0;
+        while (x < SCREEN_WIDTH)
+        {
+            if (cellUnchanged(x, y))
+            {
+                x++;
+                continue;
+            }
+
+            // Extend the run while the next change is at most 4 cells away
+            int end = x, gap = 0;
+            for (int i = x + 1; i < SCREEN_WIDTH && gap <= 4; i++)
+            {
+                if (!cellUnchanged(i, y))
+                {
+                    end = i;
+                    gap = 0;
+                }
+                else
+                    gap++;
+            }
+
+            ansiAppend(seq, snprintf(seq, sizeof(seq), "\x1b[%d;%dH", y + 1, x + 1));
+            for (; x <= end; x++)
+            {
+                ScreenCell *cell = &screen.back[y][x];
+                int blankSameBg = cell->ch == ' ' && lastAttr >= 0 &&
+                                  (cell->attr & 0xF0) == (lastAttr & 0xF0);
+                if (cell->attr != lastAttr && !blankSameBg)
+                {
+                    ansiColor(cell->attr);
+                    lastAttr = cell->attr;
+                }
+                ansiGlyph(cell->ch);
+                screen.front[y][x] = *cell;
+            }
+        }
+    }
+
+    // Park the real cursor where input is expected, in the current color
+    ansiAppend(seq, snprintf(seq, sizeof(seq), "\x1b[%d;%dH",
+                             screen.cursorY + 1, screen.cursorX + 1));
+    ansiColor(screen.attr);
+    fwrite(ansiOut, 1, ansiLen, stdout);
+    fflush(stdout);
+    ansiLen = 0;
+}
+#endif
+
+/**
+ * Prepares the console and the buffers before the first screen
+ *
+ * On POSIX terminals the line discipline is switched to unbuffered,
+ * unechoed input for the whole session; the event loop reads and
+ * echoes keys itself.
+ */
+void initScreen()
+{
+    clearScreen();
+    for (int y = 0; y < SCREEN_HEIGHT; y++)
+        invalidateRow(0, y);
+    screen.attr = 7;
+#ifndef _WIN32
+    if (tcgetattr(STDIN_FILENO, &savedTerminal) == 0)
+    {
+        struct termios raw = savedTerminal;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        terminalIsRaw = 1;
+    }
+    fputs("\x1b[2J", stdout);  // Start from a blank terminal
+#endif
+}
+
+/**
+ * Restores the terminal after the last screen
+ */
+void closeScreen()
+{
+#ifndef _WIN32
+    fprintf(stdout, "\x1b[0m\x1b[%d;1H\n", SCREEN_HEIGHT);
+    fflush(stdout);
+    if (terminalIsRaw)
+        tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+#endif
+}
+
+/**
+ * Removes the flash message from the back buffer
+ */
+void eraseFlash()
+{
+    for (int i = 0; i < flash.len; i++)
+    {
+        int x = flash.x + i;
+        if (x >= 0 && x < SCREEN_WIDTH && flash.y >= 0 && flash.y < SCREEN_HEIGHT)
+        {
+            screen.back[flash.y][x].ch = ' ';
+            screen.back[flash.y][x].attr = 7;
+        }
+    }
+    flash.active = 0;
+}
+
+/**
+ * Shows a message that fades after NOTICE_MS while input continues
+ *
+ * Replaces any message still on screen. The drawing cursor and color
+ * are left unchanged so the caller can carry on prompting.
+ *
+ * @param x X-coordinate of the message
+ * @param y Y-coordinate of the message
+ * @param color Color code of the message
+ * @param text Message text
+ */
+void flashMessage(int x, int y, int color, const char *text)
+{
+    int cursorX = screen.cursorX, cursorY = screen.cursorY, attr = screen.attr;
+    if (flash.active)
+        eraseFlash();
+
+    gotoxy(x, y);
+    setColor(color);
+    screenPrintf("%s", text);
+
+    flash.active = 1;
+    flash.x = x;
+    flash.y = y;
+    flash.len = (int)strlen(text);
+    flash.expiresAt = tickCountMs() + NOTICE_MS;
+
+    gotoxy(cursorX, cursorY);
+    setColor(attr);
+}
+
+/**
+ * Queues a message for the next menu screen
+ * Used by screens that end on an error and return straight away
+ *
+ * @param color Color code of the message
+ * @param text Message text
+ */
+void postNotice(int color, const char *text)
+{
+    snprintf(notice.text, sizeof(notice.text), "%s", text);
+    notice.color = color;
+}
+
+/**
+ * Flashes the queued notice, if any, at the given position
+ *
+ * @param x X-coordinate of the message
+ * @param y Y-coordinate of the message
+ */
+void showPostedNotice(int x, int y)
+{
+    if (notice.text[0] == 0)
+        return;
+    flashMessage(x, y, notice.color, notice.text);
+    notice.text[0] = 0;
+}
+
+#ifdef _WIN32
+/**
+ * Queues the next read of directory changes
+ *
+ * @return 1 on success, 0 on failure
+ */
+int armDataWatch()
+{
+    ResetEvent(dataWatch.overlapped.hEvent);
+    return ReadDirectoryChangesW(dataWatch.directory, dataWatch.events, sizeof(dataWatch.events), FALSE,
+                                 FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+                                 NULL, &dataWatch.overlapped, NULL) != 0;
+}
+#endif
+
+/**
+ * Starts watching the data directory for writes (once per run)
+ *
+ * Writes from any gate or process wake the live screens without
+ * polling; only changes to the spots file (replaced on every entry
+ * and exit) make them redraw.
+ */
+void openDataWatch()
+{
+    if (dataWatch.opened)
+        return;
+    dataWatch.opened = 1;
+    const char *directory = currentFacility->directory[0] ? currentFacility->directory : ".";
+#ifdef _WIN32
+    dataWatch.handle = INVALID_HANDLE_VALUE;
+    dataWatch.directory = CreateFileA(directory, FILE_LIST_DIRECTORY,
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                      OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (dataWatch.directory == INVALID_HANDLE_VALUE)
+        return;
+    dataWatch.overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    if (dataWatch.overlapped.hEvent != NULL && armDataWatch())
+        dataWatch.handle = dataWatch.overlapped.hEvent;
+    else
+        CloseHandle(dataWatch.directory);
+#elif defined(__linux__)
+    dataWatch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (dataWatch.fd >= 0 && inotify_add_watch(dataWatch.fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(dataWatch.fd);
+        dataWatch.fd = -1;
+    }
+#else
+    dataWatch.fd = -1;
+#endif
+}
+
+#ifdef _WIN32
+/**
+ * Collects the completed directory change read and queues the next one
+ *
+ * @return 1 if any change concerned the spots file (or changes were lost)
+ */
+int spotsFileChanged()
+{
+    DWORD len = 0;
+    int changed = 0;
+    if (!GetOverlappedResult(dataWatch.directory, &dataWatch.overlapped, &len, FALSE))
+        return 0;
+    if (len == 0)
+        changed = 1;  // Too many changes for the buffer
+    for (char *p = (char *)dataWatch.events; len > 0;)
+    {
+        FILE_NOTIFY_INFORMATION *event = (FILE_NOTIFY_INFORMATION *)p;
+        char name[MAX_PATH];
+        int nameLen = WideCharToMultiByte(CP_ACP, 0, event->FileName, event->FileNameLength / sizeof(WCHAR),
+                                          name, sizeof(name) - 1, NULL, NULL);
+        name[nameLen > 0 ? nameLen : 0] = '\0';
+        if (stricmp(name, FILENAME_SPOTS) == 0)
+            changed = 1;
+        if (event->NextEntryOffset == 0)
+            break;
+        p += event->NextEntryOffset;
+    }
+    armDataWatch();
+    return changed;
+}
+#elif defined(__linux__)
+/**
+ * Drains pending inotify events
+ *
+ * @return 1 if any event concerned the spots file
+ */
+int spotsFileChanged()
+{
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t len;
+    while ((len = read(dataWatch.fd, events, sizeof(events))) > 0)
+    {
+        for (char *p = events; p < events + len;)
+        {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->len > 0 && strcmp(event->name, FILENAME_SPOTS) == 0)
+                changed = 1;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+#endif
+
+/**
+ * Runs a live-screen refresh callback without disturbing the prompt
+ *
+ * @param refresh Redraws the live part of the screen
+ */
+void runRefresh(void (*refresh)(void))
+{
+    int x = screen.cursorX, y = screen.cursorY, attr = screen.attr;
+    refresh();
+    gotoxy(x, y);
+    setColor(attr);
+}
+
+/**
+ * UI event loop: waits for the next key press
+ *
+ * While waiting it expires the flash message on its timer and, when a
+ * refresh callback is given, redraws live data whenever the data files
+ * change. Nothing polls; the thread sleeps until input, a file change
+ * or the next timer deadline. Each event is shown with one present.
+ *
+ * @param refresh Redraws the live part of the screen, or NULL
+ * @return Character code of the key pressed, or EOF if input closed
+ */
+int nextKey(void (*refresh)(void))
+{
+    if (refresh != NULL)
+        openDataWatch();
+
+    for (;;)
+    {
+        presentScreen();
+
+        unsigned timeout = exportMetricsIfDue();
+        if (flash.active)
+        {
+            unsigned long long now = tickCountMs();
+            unsigned flashLeft = flash.expiresAt > now ? (unsigned)(flash.expiresAt - now) : 0;
+            if (flashLeft < timeout)
+                timeout = flashLeft;
+        }
+
+#ifdef _WIN32
+        if (_kbhit())
+        {
+            int key = _getch();
+            if (key == 0 || key == 224)
+            {
+                _getch();  // Ignore function and arrow keys
+                continue;
+            }
+            return key;
+        }
+
+        HANDLE handles[2] = {GetStdHandle(STD_INPUT_HANDLE), dataWatch.handle};
+        DWORD count = refresh != NULL && dataWatch.handle != INVALID_HANDLE_VALUE &&
+                      dataWatch.handle != NULL ? 2 : 1;
+        DWORD which = WaitForMultipleObjects(count, handles, FALSE,
+                                             timeout == WAIT_FOREVER ? INFINITE : timeout);
+        if (which == WAIT_OBJECT_0)
+        {
+            // Mouse, focus and key-up events also signal the input handle
+            if (!_kbhit())
+                FlushConsoleInputBuffer(handles[0]);
+        }
+        else if (which == WAIT_OBJECT_0 + 1)
+        {
+            // History appends and the metrics file also wake us; only spot changes redraw
+            if (spotsFileChanged())
+                runRefresh(refresh);
+        }
+        else if (which == WAIT_FAILED)
+        {
+            return _getch();
+        }
+#else
+        struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {dataWatch.fd, POLLIN, 0}};
+        int count = refresh != NULL && dataWatch.fd >= 0 ? 2 : 1;
+        if (poll(fds, count, timeout == WAIT_FOREVER ? -1 : (int)timeout) < 0)
+            continue;  // Interrupted by a signal
+
+        if (fds[0].revents)
+        {
+            unsigned char c;
+            if (read(STDIN_FILENO, &c, 1) != 1)
+                return EOF;
+            if (c == 27)
+            {
+                // Swallow the rest of an escape sequence (arrow keys etc.)
+                struct pollfd more = {STDIN_FILENO, POLLIN, 0};
+                while (poll(&more, 1, 0) > 0 && read(STDIN_FILENO, &c, 1) == 1)
+                    ;
+                continue;
+            }
+            return c;
+        }
+#ifdef __linux__
+        if (count == 2 && (fds[1].revents & POLLIN) && spotsFileChanged())
+            runRefresh(refresh);
+#endif
+#endif
+
+        if (flash.active && tickCountMs() >= flash.expiresAt)
+            eraseFlash();
+    }
+}
+
+/**
+ * Waits for a key press while keeping the screen live
+ *
+ * @param echo 1 to draw the pressed key at the cursor
+ * @param refresh Redraws the live part of the screen when data changes
+ * @return Character code of the key pressed
+ */
+int readKeyLive(int echo, void (*refresh)(void))
+{
+    int key = nextKey(refresh);
+    if (echo && isprint(key))
+    {
+        putCell((unsigned char)key);
+        presentScreen();
+    }
+    return key;
+}
+
+/**
+ * Shows the current frame and waits for a single key press
+ *
+ * @param echo 1 to draw the pressed key at the cursor
+ * @return Character code of the key pressed
+ */
+int readKey(int echo)
+{
+    return readKeyLive(echo, NULL);
+}
+
+/**
+ * Reads a line of input at the cursor with simple editing
+ *
+ * Keys are echoed into the screen buffer; Backspace deletes and Enter
+ * finishes. Flash messages keep fading while the operator types.
+ *
+ * @param buffer Receives the text (without newline)
+ * @param size Size of buffer
+ */
+void readLine(char *buffer, int size)
+{
+    int x = screen.cursorX, y = screen.cursorY;
+    int len = 0;
+
+    for (;;)
+    {
+        int key = nextKey(NULL);
+        if (key == '\r' || key == '\n' || key == EOF)
+            break;
+        if ((key == 8 || key == 127) && len > 0)
+        {
+            len--;
+            gotoxy(x + len, y);
+            putCell(' ');
+            gotoxy(x + len, y);
+        }
+        else if (isprint(key) && len < size - 1)
+        {
+            buffer[len++] = (char)key;
+            putCell((unsigned char)key);
+        }
+    }
+    buffer[len] = 0;
+}
+
+/**
+ * Draws a rectangular border using ASCII extended characters
+ * 
+ * @param width Width of the border in characters
+ * @param height Height of the border in characters
+ * @param x X-coordinate of the top-left corner
+ * @param y Y-coordinate of the top-left corner
+ */
+void drawBorder(int width, int height, int x, int y)
+{
+    // Draw top border with corners
+    gotoxy(x, y);
+    putCell(201);  // Top-left corner
+    for (int i = 0; i < width - 2; i++)
+        putCell(205);  // Horizontal line
+    putCell(187);  // Top-right corner
+
+    // Draw vertical borders
+    for (int i = 1; i < height - 1; i++)
+    {
+        gotoxy(x, y + i);
+        putCell(186);  // Left vertical line
+        gotoxy(x + width - 1, y + i);
+        putCell(186);  // Right vertical line
+    }
+
+    // Draw bottom border with corners
+    gotoxy(x, y + height - 1);
+    putCell(200);  // Bottom-left corner
+    for (int i = 0; i < width - 2; i++)
+        putCell(205);  // Horizontal line
+    putCell(188);  // Bottom-right corner
+}
+
+/**
+ * Initializes the parking spots data file
+ * 
+ * Creates a new parking spots file if it doesn't exist.
+ * Each line in the file represents one parking spot with format:
+ * [spot_number] [license_plate] [occupied_flag] [entry_time]
+ */
+void initializeParkingSpots()
+{
+    FILE *file = openDataFile(FILENAME_SPOTS, "r");
+    if (file != NULL)
+    {
+        // File exists, no need to initialize
+        fclose(file);
+        return;
+    }
+
+    // File doesn't exist, create it with all spots empty (unless another process just did)
+    beginHistoryWrite();
+    file = openDataFile(FILENAME_SPOTS, "r");
+    if (file != NULL)
+        fclose(file);
+    else if ((file = openDataFile(FILENAME_SPOTS ".tmp", "w")) != NULL)
+    {
+        for (int i = 0; i < PARKING_SPOTS; i++)
+        {
+            fprintf(file, "%d EMPTY 0 0\n", i + 1);
+        }
+        if (fclose(file) == 0)
+            replaceDataFile(FILENAME_SPOTS ".tmp", FILENAME_SPOTS);
+    }
+    endHistoryWrite();
+}
+
+/**
+ * Allocates an empty spot table
+ *
+ * @param table Table to set up; release with freeSpotTable()
+ * @param count Number of bays
+ * @return 1 on success, 0 if memory ran out
+ */
+int allocSpotTable(SpotTable *table, int count)
+{
+    // One block: bitset, then entry times, then plates
+    size_t bits = SPOT_WORDS(count) * sizeof(uint64_t);
+    size_t times = (size_t)count * sizeof(int64_t);
+    char *block = calloc(1, bits + times + (size_t)count * sizeof(table->plates[0]));
+    table->count = block != NULL ? count : 0;
+    table->occupied = (uint64_t *)block;
+    table->entryTimes = (int64_t *)(block + bits);
+    table->plates = (char (*)[20])(block + bits + times);
+    return block != NULL;
+}
+
+/**
+ * Releases a spot table
+ *
+ * @param table Table from allocSpotTable() or loadSpotTable()
+ */
+void freeSpotTable(SpotTable *table)
+{
+    free(table->occupied);
+    table->occupied = NULL;
+    table->count = 0;
+}
+
+/**
+ * Tells whether a spot is occupied
+ *
+ * @param table Spot table
+ * @param spot Spot number (1-based)
+ * @return 1 if occupied, 0 otherwise
+ */
+int spotOccupied(const SpotTable *table, int spot)
+{
+    return (int)((table->occupied[(spot - 1) / 64] >> ((spot - 1) % 64)) & 1);
+}
+
+/**
+ * Puts a car in a spot, or empties it
+ *
+ * @param table Spot table
+ * @param spot Spot number (1-based)
+ * @param plate Plate of the car, NULL to empty the spot
+ * @param entryTime Entry time of the car
+ */
+void setSpot(SpotTable *table, int spot, const char *plate, time_t entryTime)
+{
+    uint64_t bit = (uint64_t)1 << ((spot - 1) % 64);
+    if (plate != NULL)
+    {
+        table->occupied[(spot - 1) / 64] |= bit;
+        snprintf(table->plates[spot - 1], sizeof(table->plates[0]), "%s", plate);
+        table->entryTimes[spot - 1] = (int64_t)entryTime;
+    }
+    else
+    {
+        table->occupied[(spot - 1) / 64] &= ~bit;
+        strcpy(table->plates[spot - 1], "EMPTY");
+        table->entryTimes[spot - 1] = 0;
+    }
+}
+
+/**
+ * Counts occupied spots, a word of the bitset at a time
+ *
+ * @param table Spot table
+ * @return Number of occupied spots
+ */
+int countOccupiedSpots(const SpotTable *table)
+{
+    int count = 0;
+    for (int w = 0; w < SPOT_WORDS(table->count); w++)
+        count += POPCOUNT64(table->occupied[w]);
+    return count;
+}
+
+/**
+ * Finds the next free spot, skipping full words of the bitset
+ *
+ * @param table Spot table
+ * @param after Spot to start after (0 = from the first spot)
+ * @return Spot number, 0 if no later spot is free
+ */
+int nextFreeSpot(const SpotTable *table, int after)
+{
+    for (int w = after / 64; w < SPOT_WORDS(table->count); w++)
+    {
+        uint64_t free = ~table->occupied[w];
+        if (w == after / 64)
+            free &= ~(uint64_t)0 << (after % 64);  // Spots up to "after" are done
+        if (free != 0)
+        {
+            int spot = w * 64 + LOWEST_BIT64(free) + 1;
+            return spot <= table->count ? spot : 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Finds the next occupied spot, skipping empty words of the bitset
+ *
+ * @param table Spot table
+ * @param after Spot to start after (0 = from the first spot)
+ * @return Spot number, 0 if no later spot is occupied
+ */
+int nextOccupiedSpot(const SpotTable *table, int after)
+{
+    for (int w = after / 64; w < SPOT_WORDS(table->count); w++)
+    {
+        uint64_t used = table->occupied[w];
+        if (w == after / 64)
+            used &= ~(uint64_t)0 << (after % 64);
+        if (used != 0)
+            return w * 64 + LOWEST_BIT64(used) + 1;
+    }
+    return 0;
+}
+
+/**
+ * Finds the spot a plate is parked in
+ *
+ * Only the plates of occupied spots are compared.
+ *
+ * @param table Spot table
+ * @param plate License plate (case-insensitive)
+ * @return Spot number, 0 if the plate is not parked
+ */
+int findParkedSpot(const SpotTable *table, const char *plate)
+{
+    for (int spot = nextOccupiedSpot(table, 0); spot != 0; spot = nextOccupiedSpot(table, spot))
+    {
+        if (stricmp(table->plates[spot - 1], plate) == 0)
+            return spot;
+    }
+    return 0;
+}
+
+/**
+ * Loads the current state of all parking spots
+ *
+ * @param table Receives the spots; release with freeSpotTable(), even on failure
+ * @return 1 on success, 0 if the spots file could not be read
+ */
+int loadSpotTable(SpotTable *table)
+{
+    table->occupied = NULL;
+    if (!allocSpotTable(table, PARKING_SPOTS))
+        return 0;
+    FILE *file = openDataFile(FILENAME_SPOTS, "r");
+    if (file == NULL)
+        return 0;
+
+    char line[64];
+    int rows = 0;
+    while (rows < table->count && fgets(line, sizeof(line), file))
+    {
+        // "spot plate occupied entry_time"
+        char *end, plate[20];
+        long spot = strtol(line, &end, 10);
+        if (spot < 1 || spot > table->count || sscanf(end, " %19s", plate) != 1)
+            break;
+        char *flags = strstr(end, plate) + strlen(plate);
+        long occupied = strtol(flags, &end, 10);
+        long long entryTime = strtoll(end, &end, 10);
+        if (occupied)
+            setSpot(table, (int)spot, plate, (time_t)entryTime);
+        else
+            setSpot(table, (int)spot, NULL, 0);
+        rows++;
+    }
+    METRIC_ADD(METRIC_BYTES_READ, ftell(file));
+    METRIC_ADD(METRIC_RECORDS_SCANNED, rows);
+    fclose(file);
+    if (rows != table->count)
+        return 0;
+
+    setGauge(METRIC_SPOTS_OCCUPIED, countOccupiedSpots(table));
+    return 1;
+}
+
+/**
+ * Writes a spot table to an open spots file
+ *
+ * @param table Spot table
+ * @param file Spots file, opened for writing
+ */
+void writeSpotTable(const SpotTable *table, FILE *file)
+{
+    for (int spot = 1; spot <= table->count; spot++)
+    {
+        fprintf(file, "%d %s %d %lld\n", spot, table->plates[spot - 1],
+                spotOccupied(table, spot), (long long)table->entryTimes[spot - 1]);
+    }
+}
+
+/**
+ * Flushes a data file and, when GROUP_COMMIT_SYNC is enabled,
+ * forces it to disk
+ *
+ * @param file Open file to sync
+ * @return 1 on success, 0 on failure
+ */
+int syncFile(FILE *file)
+{
+    METRIC_START(start);
+    int ok = fflush(file) == 0;
+#if GROUP_COMMIT_SYNC
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+#endif
+    METRIC_ADD(METRIC_FILE_SYNCS, 1);
+    METRIC_OBSERVE(METRIC_FILE_SYNC, start);
+    return ok;
+}
+
+/**
+ * Applies the spot changes of a batch and rewrites the spots file once
+ *
+ * Events whose spot was taken (entry) or whose car is no longer parked
+ * (exit) are marked as conflicts and skipped. The new file is written
+ * and synced under another name and then swapped in, so readers and a
+ * crash never see it half written. Call between beginHistoryWrite()
+ * and endHistoryWrite().
+ *
+ * @param batch Events in submission order
+ * @param count Number of events in the batch
+ * @return 1 on success, 0 if the spots file could not be read or written
+ */
+int applySpotChanges(JournalEvent **batch, int count)
+{
+    SpotTable spots;
+    if (!loadSpotTable(&spots))
+    {
+        freeSpotTable(&spots);
+        return 0;
+    }
+
+    for (int e = 0; e < count; e++)
+    {
+        CarRecord *record = &batch[e]->record;
+        int spot = record->spot;
+        batch[e]->status = COMMIT_CONFLICT;
+        if (spot < 1 || spot > spots.count)
+            continue;
+        if (batch[e]->type == JOURNAL_ENTRY && !spotOccupied(&spots, spot))
+        {
+            setSpot(&spots, spot, record->plate, record->entry_time);
+            batch[e]->status = COMMIT_OK;
+        }
+        else if (batch[e]->type == JOURNAL_EXIT && spotOccupied(&spots, spot) &&
+                 strcmp(spots.plates[spot - 1], record->plate) == 0)
+        {
+            setSpot(&spots, spot, NULL, 0);
+            batch[e]->status = COMMIT_OK;
+        }
+    }
+
+    FILE *file = openDataFile(FILENAME_SPOTS ".tmp", "w");
+    if (file == NULL)
+    {
+        freeSpotTable(&spots);
+        return 0;
+    }
+    writeSpotTable(&spots, file);
+    METRIC_ADD(METRIC_BYTES_WRITTEN, ftell(file));
+    setGauge(METRIC_SPOTS_OCCUPIED, countOccupiedSpots(&spots));
+    freeSpotTable(&spots);
+    int ok = syncFile(file);
+    ok = fclose(file) == 0 && ok;
+    return ok && replaceDataFile(FILENAME_SPOTS ".tmp", FILENAME_SPOTS);
+}
+
+/**
+ * Appends the open history rows of all accepted entries in a batch
+ *
+ * @param batch Events in submission order
+ * @param count Number of events in the batch
+ * @return 1 on success, 0 if the history file could not be written
+ */
+int appendHistoryEntries(JournalEvent **batch, int count)
+{
+    FILE *file = openDataFile(FILENAME_HISTORY, "a");
+    if (file == NULL)
+        return 0;
+    long written = 0;
+    for (int e = 0; e < count; e++)
+    {
+        CarRecord *record = &batch[e]->record;
+        if (batch[e]->type != JOURNAL_ENTRY || batch[e]->status != COMMIT_OK)
+            continue;
+        written += fprintf(file, "%s,%s,%s,%s,%d,%lld,%lld,%.2f\n",
+                record->name, record->plate, record->phone,
+                record->address, record->spot, (long long)record->entry_time,
+                (long long)record->exit_time, record->fee);
+    }
+    METRIC_ADD(METRIC_BYTES_WRITTEN, written);
+    int ok = syncFile(file);
+    fclose(file);
+    return ok;
+}
+
+/**
+ * Closes the open history rows of all accepted exits in a batch
+ *
+ * The file is read once. Everything from the first row being closed
+ * to the end of file is rebuilt in memory and written back in one go,
+ * so longer closed rows cannot overwrite the rows that follow them.
+ *
+ * @param batch Events in submission order
+ * @param count Number of events in the batch
+ * @param changedFrom Receives the offset of the first rewritten byte (unchanged if none)
+ * @return 1 on success, 0 if the history file could not be written
+ */
+int closeHistorySessions(JournalEvent **batch, int count, long *changedFrom)
+{
+    int exits = 0;
+    for (int e = 0; e < count; e++)
+    {
+        if (batch[e]->type == JOURNAL_EXIT && batch[e]->status == COMMIT_OK)
+            exits++;
+    }
+    if (exits == 0)
+        return 1;
+
+    FILE *file = openDataFile(FILENAME_HISTORY, "r+");
+    if (file == NULL)
+        return 0;
+
+    int closed[GROUP_COMMIT_MAX_BATCH] = {0};  // Exits already matched to a row
+    char *tail = NULL;       // Rebuilt text from the first closed row onwards
+    size_t tailLen = 0, tailCap = 0;
+    long tailStart = -1;
+    long pos = 0;
+    char line[256];
+
+    while (fgets(line, sizeof(line), file))
+    {
+        CarRecord record;
+        char out[256];
+        const char *text = line;
+        METRIC_ADD(METRIC_BYTES_READ, strlen(line));
+        METRIC_ADD(METRIC_RECORDS_SCANNED, 1);
+        int fields = sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld,%lf",
+                            record.name, record.plate, record.phone,
+                            record.address, &record.spot, &record.entry_time,
+                            &record.exit_time, &record.fee);
+
+        if (fields == 8 && record.exit_time == 0)
+        {
+            for (int e = 0; e < count; e++)
+            {
+                if (closed[e] || batch[e]->type != JOURNAL_EXIT ||
+                    batch[e]->status != COMMIT_OK ||
+                    strcmp(batch[e]->record.plate, record.plate) != 0)
+                    continue;
+
+                closed[e] = 1;
+                record.exit_time = batch[e]->record.exit_time;
+                record.fee = batch[e]->record.fee;
+                snprintf(out, sizeof(out), "%s,%s,%s,%s,%d,%lld,%lld,%.2f\n",
+                         record.name, record.plate, record.phone,
+                         record.address, record.spot, (long long)record.entry_time,
+                         (long long)record.exit_time, record.fee);
+                text = out;
+                if (tailStart < 0)
+                    tailStart = pos;
+                break;
+            }
+        }
+
+        if (tailStart >= 0)
+        {
+            size_t len = strlen(text);
+            if (tailLen + len + 1 > tailCap)
+            {
+                tailCap = (tailCap + len + 1) * 2;
+                char *grown = realloc(tail, tailCap);
+                if (grown == NULL)
+                {
+                    free(tail);
+                    fclose(file);
+                    return 0;
+                }
+                tail = grown;
+            }
+            memcpy(tail + tailLen, text, len + 1);
+            tailLen += len;
+        }
+        pos = ftell(file);
+    }
+
+    // Closed rows are never shorter than open ones, so no truncation is needed
+    int ok = 1;
+    if (tailStart >= 0)
+    {
+        *changedFrom = tailStart;
+        fseek(file, tailStart, SEEK_SET);
+        ok = fputs(tail, file) >= 0 && syncFile(file);
+        METRIC_ADD(METRIC_BYTES_WRITTEN, tailLen);
+    }
+    free(tail);
+    fclose(file);
+    return ok;
+}
+
+/**
+ * Returns the current size of the history file
+ *
+ * @return Size in bytes, -1 if there is no history file
+ */
+long historyFileSize()
+{
+    FILE *file = openDataFile(FILENAME_HISTORY, "r");
+    if (file == NULL)
+        return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+/**
+ * Counts one more matching row in a search result
+ *
+ * @param result Search result
+ * @param other Plate (search by name) or owner (search by plate) of the row
+ */
+void addSearchMatch(SearchResult *result, const char *other)
+{
+    result->totalEntries++;
+
+    for (int i = 0; i < result->count; i++)
+    {
+        if (stricmp(result->matches[i], other) == 0)
+            return;
+    }
+    if (result->count < SEARCH_MAX_MATCHES)
+        strcpy(result->matches[result->count++], other);
+}
+
+/**
+ * Prepares a search cache; call once before any search or write
+ *
+ * @param cache Search cache
+ */
+void initSearchCache(SearchCache *cache)
+{
+    mutexInit(&cache->lock);
+    cache->historySize = -1;
+}
+
+/**
+ * Drops all cached searches
+ *
+ * @param historySize File size the (now empty) cache is valid for
+ */
+void clearSearchCache(long historySize)
+{
+    for (int i = 0; i < SEARCH_CACHE_SIZE; i++)
+        currentFacility->searchCache.entries[i].used = 0;
+    currentFacility->searchCache.historySize = historySize;
+    currentFacility->searchCache.writes = currentFacility->marker.writes;
+}
+
+/**
+ * Folds the history rows appended by a batch into the cached results
+ *
+ * Called with the cache lock held, after the batch was written. Exits
+ * only change exit time and fee, which searches do not report.
+ *
+ * @param batch Events in submission order
+ * @param count Number of events in the batch
+ * @param before History size before the batch was written
+ * @param after History size after the batch was written
+ */
+void updateSearchCache(JournalEvent **batch, int count, long before, long after)
+{
+    SearchCache *cache = &currentFacility->searchCache;
+    if (before != cache->historySize || currentFacility->marker.writes != cache->writes)
+    {
+        clearSearchCache(after);  // Someone else changed the file first
+        return;
+    }
+
+    for (int e = 0; e < count; e++)
+    {
+        const CarRecord *record = &batch[e]->record;
+        if (batch[e]->type != JOURNAL_ENTRY || batch[e]->status != COMMIT_OK)
+            continue;
+        for (int i = 0; i < SEARCH_CACHE_SIZE; i++)
+        {
+            SearchCacheEntry *entry = &cache->entries[i];
+            if (!entry->used)
+                continue;
+            if (entry->field == SEARCH_BY_NAME && stricmp(entry->key, record->name) == 0)
+                addSearchMatch(&entry->result, record->plate);
+            else if (entry->field == SEARCH_BY_PLATE && stricmp(entry->key, record->plate) == 0)
+                addSearchMatch(&entry->result, record->name);
+        }
+    }
+    cache->historySize = after;
+}
+
+/**
+ * Writes one batch of journal events: spots file first, then history
+ *
+ * @param batch Events in submission order
+ * @param count Number of events in the batch
+ */
+void writeJournalBatch(JournalEvent **batch, int count)
+{
+    METRIC_START(start);
+
+    // Searches wait for the batch, so they never see the file without its cache update;
+    // writers in other processes wait on the lock file
+    int ok = beginHistoryWrite();
+    long before = historyFileSize();
+    long changedFrom = LONG_MAX;
+    ok = ok && applySpotChanges(batch, count);
+    if (ok)
+        ok = appendHistoryEntries(batch, count) && closeHistorySessions(batch, count, &changedFrom);
+
+    long after = historyFileSize();
+    if (ok)
+        updateSearchCache(batch, count, before, after);
+    else
+    {
+        clearSearchCache(-1);
+        for (int e = 0; e < count; e++)
+            batch[e]->status = COMMIT_IO_ERROR;
+    }
+    // Tell readers and a running compaction, in any process, which part of the file changed
+    if (ok && after != before && before < changedFrom)
+        changedFrom = before > 0 ? before : 0;  // Appends start at the old end of file
+    if (!ok)
+        changedFrom = 0;
+    if (changedFrom != LONG_MAX && currentFacility->writeLocked)
+        noteHistoryWrite(changedFrom);
+    currentFacility->searchCache.writes = currentFacility->marker.writes;  // Includes this batch
+    endHistoryWrite();
+    METRIC_ADD(METRIC_COMMIT_BATCHES, 1);
+    METRIC_ADD(METRIC_COMMIT_EVENTS, count);
+    METRIC_OBSERVE(METRIC_BATCH_WRITE, start);
+}
+
+/**
+ * Group commit writer thread
+ *
+ * Waits for queued events, gathers a batch until it is full or
+ * GROUP_COMMIT_MAX_DELAY_MS has passed since the first event arrived,
+ * writes it with one sync per file and then releases all waiting callers.
+ *
+ * @param param Unused
+ * @return Never returns while the program runs
+ */
+THREAD_RETURN groupCommitThread(void *param)
+{
+    currentFacility = param;  // The writer serves the facility that started it
+    GroupCommitWriter *writer = &currentFacility->journalWriter;
+    JournalEvent *batch[GROUP_COMMIT_MAX_BATCH];
+
+    mutexLock(&writer->lock);
+    for (;;)
+    {
+        while (writer->head == NULL)
+            condWait(&writer->pending, &writer->lock, WAIT_FOREVER);
+
+        // Let other threads of this process join the batch, bounded by the latency budget
+        unsigned long long start = tickCountMs();
+        while (writer->queued < GROUP_COMMIT_MAX_BATCH)
+        {
+            unsigned elapsed = (unsigned)(tickCountMs() - start);
+            if (elapsed >= GROUP_COMMIT_MAX_DELAY_MS)
+                break;
+            condWait(&writer->pending, &writer->lock,
+                     GROUP_COMMIT_MAX_DELAY_MS - elapsed);
+        }
+
+        int count = 0;
+        while (writer->head != NULL && count < GROUP_COMMIT_MAX_BATCH)
+        {
+            batch[count++] = writer->head;
+            writer->head = writer->head->next;
+            writer->queued--;
+        }
+        if (writer->head == NULL)
+            writer->tail = NULL;
+        setGauge(METRIC_COMMIT_QUEUE_DEPTH, writer->queued);
+
+        mutexUnlock(&writer->lock);
+        writeJournalBatch(batch, count);
+        mutexLock(&writer->lock);
+
+        // Acknowledge only now that the whole batch is durable
+        for (int e = 0; e < count; e++)
+            batch[e]->durable = 1;
+        condBroadcast(&writer->committed);
+    }
+    return 0;
+}
+
+/**
+ * Starts the group commit writer thread of the current facility
+ *
+ * Must be called once before any journal event is committed
+ */
+void startGroupCommitWriter()
+{
+    GroupCommitWriter *writer = &currentFacility->journalWriter;
+    mutexInit(&writer->lock);
+    condInit(&writer->pending);
+    condInit(&writer->committed);
+    writer->head = writer->tail = NULL;
+    writer->queued = 0;
+
+    Thread thread;
+    writer->started = threadStart(&thread, groupCommitThread, currentFacility);
+    if (writer->started)
+        threadDetach(thread);
+}
+
+/**
+ * Queues a journal event and waits until its batch is on disk
+ *
+ * Falls back to writing the event directly if the writer thread
+ * could not be started.
+ *
+ * @param event Event to commit (must stay valid until this returns)
+ * @return Commit status of the event
+ */
+CommitStatus commitJournalEvent(JournalEvent *event)
+{
+    GroupCommitWriter *writer = &currentFacility->journalWriter;
+    event->durable = 0;
+    event->next = NULL;
+
+    if (!writer->started)
+    {
+        writeJournalBatch(&event, 1);
+        return event->status;
+    }
+
+    METRIC_START(start);
+    mutexLock(&writer->lock);
+    METRIC_OBSERVE(METRIC_LOCK_WAIT, start);
+    if (writer->tail != NULL)
+        writer->tail->next = event;
+    else
+        writer->head = event;
+    writer->tail = event;
+    writer->queued++;
+    setGauge(METRIC_COMMIT_QUEUE_DEPTH, writer->queued);
+    condSignal(&writer->pending);
+
+    while (!event->durable)
+        condWait(&writer->committed, &writer->lock, WAIT_FOREVER);
+    mutexUnlock(&writer->lock);
+    METRIC_OBSERVE(METRIC_COMMIT_WAIT, start);
+
+    return event->status;
+}
+
+/**
+ * Checks that a phone number has exactly 10 digits
+ *
+ * @param phone Phone number text
+ * @return 1 if valid, 0 otherwise
+ */
+int isValidPhone(const char *phone)
+{
+    if (strlen(phone) != 10)
+        return 0;
+    for (int i = 0; phone[i]; i++)
+    {
+        if (!isdigit((unsigned char)phone[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Returns the operator message for an operation status
+ *
+ * @param status Operation status
+ * @return Message text
+ */
+const char *opStatusMessage(OpStatus status)
+{
+    switch (status)
+    {
+    case OP_OK:             return "OK";
+    case OP_EMPTY_NAME:     return "Name cannot be empty!";
+    case OP_EMPTY_PLATE:    return "Plate cannot be empty!";
+    case OP_INVALID_PHONE:  return "Invalid phone! 10 digits required!";
+    case OP_EMPTY_ADDRESS:  return "Address cannot be empty!";
+    case OP_INVALID_SPOT:   return "Invalid or occupied spot!";
+    case OP_ALREADY_PARKED: return "Car already parked!";
+    case OP_NOT_PARKED:     return "Invalid car entry!";
+    case OP_RESERVED:       return "Spot is reserved!";
+    case OP_NO_VACANCY:     return "No free spot!";
+    case OP_INVALID_TIME:   return "Invalid time window!";
+    case OP_NO_RESERVATION: return "No such reservation!";
+    default:                return "Error saving parking data!";
+    }
+}
+
+/**
+ * Returns the machine-readable code for an operation status
+ *
+ * @param status Operation status
+ * @return Short lower-case code, as printed by the command-line interface
+ */
+const char *opStatusCode(OpStatus status)
+{
+    switch (status)
+    {
+    case OP_OK:             return "ok";
+    case OP_EMPTY_NAME:     return "empty_name";
+    case OP_EMPTY_PLATE:    return "empty_plate";
+    case OP_INVALID_PHONE:  return "invalid_phone";
+    case OP_EMPTY_ADDRESS:  return "empty_address";
+    case OP_INVALID_SPOT:   return "invalid_spot";
+    case OP_ALREADY_PARKED: return "already_parked";
+    case OP_NOT_PARKED:     return "not_parked";
+    case OP_RESERVED:       return "reserved";
+    case OP_NO_VACANCY:     return "no_vacancy";
+    case OP_INVALID_TIME:   return "invalid_time";
+    case OP_NO_RESERVATION: return "no_reservation";
+    default:                return "io_error";
+    }
+}
+
+/**
+ * Checks the owner fields the way the Add Car screen does
+ *
+ * @param car Record to check
+ * @return OP_OK or the first invalid field
+ */
+OpStatus validateCarFields(const CarRecord *car)
+{
+    if (strlen(car->name) == 0)
+        return OP_EMPTY_NAME;
+    if (strlen(car->plate) == 0)
+        return OP_EMPTY_PLATE;
+    if (!isValidPhone(car->phone))
+        return OP_INVALID_PHONE;
+    if (strlen(car->address) == 0)
+        return OP_EMPTY_ADDRESS;
+    return OP_OK;
+}
+
+/**
+ * Returns the level (1-based) a parking spot is on
+ *
+ * @param spot Spot number
+ * @return Level number
+ */
+int spotLevel(int spot)
+{
+    return (spot - 1) / SPOTS_PER_LEVEL + 1;
+}
+
+/**
+ * Finds the first booking of a bay that ends after a time
+ *
+ * @param bay Bookings of one bay
+ * @param time Time to look from
+ * @return Index of the booking, bay->count if there is none
+ */
+int findReservation(const BayReservations *bay, time_t time)
+{
+    int low = 0, high = bay->count;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (bay->items[mid].end <= time)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+/**
+ * Returns the booking of a bay that overlaps a time window, if any
+ *
+ * @param bay Bookings of one bay
+ * @param from Start of the window
+ * @param to End of the window (exclusive)
+ * @return Earliest overlapping booking, NULL if the bay is free
+ */
+const Reservation *reservationOverlap(const BayReservations *bay, time_t from, time_t to)
+{
+    int i = findReservation(bay, from);
+    return i < bay->count && bay->items[i].start < to ? &bay->items[i] : NULL;
+}
+
+/**
+ * Returns the bookings of one bay
+ *
+ * @param book Reservation book
+ * @param spot Spot number
+ * @return Its bookings (empty if no bay has been booked yet)
+ */
+const BayReservations *bayReservations(const ReservationBook *book, int spot)
+{
+    static const BayReservations none = {0};
+    return spot <= book->bayCount ? &book->bays[spot - 1] : &none;
+}
+
+/**
+ * Adds a booking to a bay, keeping the bay sorted
+ *
+ * @param book Reservation book
+ * @param spot Spot number
+ * @param reservation Booking to add
+ * @return 1 if added, 0 if it overlaps another booking or memory ran out
+ */
+int addReservation(ReservationBook *book, int spot, const Reservation *reservation)
+{
+    if (book->bays == NULL)
+    {
+        book->bays = calloc(PARKING_SPOTS, sizeof(BayReservations));
+        if (book->bays == NULL)
+            return 0;
+        book->bayCount = PARKING_SPOTS;
+    }
+    BayReservations *bay = &book->bays[spot - 1];
+    if (reservationOverlap(bay, reservation->start, reservation->end) != NULL)
+        return 0;
+    if (bay->count == bay->capacity)
+    {
+        int capacity = bay->capacity ? bay->capacity * 2 : 8;
+        Reservation *grown = realloc(bay->items, capacity * sizeof(Reservation));
+        if (grown == NULL)
+            return 0;
+        bay->items = grown;
+        bay->capacity = capacity;
+    }
+
+    int i = findReservation(bay, reservation->start);
+    memmove(&bay->items[i + 1], &bay->items[i], (bay->count - i) * sizeof(Reservation));
+    bay->items[i] = *reservation;
+    bay->count++;
+    book->count++;
+    return 1;
+}
+
+/**
+ * Removes a booking from a bay
+ *
+ * @param book Reservation book
+ * @param spot Spot number
+ * @param id Booking number
+ * @return 1 if removed, 0 if the bay has no such booking
+ */
+int dropReservation(ReservationBook *book, int spot, int id)
+{
+    if (spot > book->bayCount)
+        return 0;
+    BayReservations *bay = &book->bays[spot - 1];
+    for (int i = 0; i < bay->count; i++)
+    {
+        if (bay->items[i].id != id)
+            continue;
+        memmove(&bay->items[i], &bay->items[i + 1], (bay->count - i - 1) * sizeof(Reservation));
+        bay->count--;
+        book->count--;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Parses one line of the reservation file
+ *
+ * @param line "id,plate,spot,start,end,state" (modified)
+ * @param reservation Receives the booking
+ * @param spot Receives the spot number
+ * @param cancelled Receives 1 for a cancellation, 0 for a booking
+ * @return 1 on success, 0 if the line is malformed
+ */
+int parseReservationLine(char *line, Reservation *reservation, int *spot, int *cancelled)
+{
+    char *end;
+    reservation->id = (int)strtol(line, &end, 10);
+    if (end == line || *end != ',')
+        return 0;
+    char *plate = end + 1;
+    end = strchr(plate, ',');
+    if (end == NULL || end - plate >= (long)sizeof(reservation->plate))
+        return 0;
+    memcpy(reservation->plate, plate, end - plate);
+    reservation->plate[end - plate] = '\0';
+
+    char *field = end + 1;
+    *spot = (int)strtol(field, &end, 10);
+    if (end == field || *end != ',' || *spot < 1 || *spot > PARKING_SPOTS)
+        return 0;
+    field = end + 1;
+    reservation->start = (time_t)strtoll(field, &end, 10);
+    if (end == field || *end != ',')
+        return 0;
+    field = end + 1;
+    reservation->end = (time_t)strtoll(field, &end, 10);
+    if (end == field || *end != ',')
+        return 0;
+    *cancelled = strncmp(end + 1, "cancelled", 9) == 0;
+    return *cancelled || strncmp(end + 1, "booked", 6) == 0;
+}
+
+/**
+ * Prepares a reservation book
+ *
+ * @param book Reservation book
+ */
+void initReservations(ReservationBook *book)
+{
+    memset(book, 0, sizeof(*book));
+    mutexInit(&book->lock);
+    book->nextId = 1;
+}
+
+/**
+ * Brings the reservation book up to date with the reservation file
+ *
+ * The file only grows: each line books a window or cancels one, so new
+ * lines are applied incrementally from the last offset. Bookings that
+ * have already ended are not kept. If two bookings for the same bay
+ * overlap (made by two processes at once), the first one written wins.
+ * Call with book->lock held.
+ *
+ * @param book Reservation book
+ */
+void refreshReservations(ReservationBook *book)
+{
+    FILE *file = openDataFile(FILENAME_RESERVATIONS, "r");
+    if (file == NULL)
+        return;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    if (size < book->fileOffset)
+    {
+        // File was replaced: start over
+        for (int i = 0; i < book->bayCount; i++)
+            book->bays[i].count = 0;
+        book->count = 0;
+        book->fileOffset = 0;
+    }
+
+    if (size > book->fileOffset)
+    {
+        time_t now = time(NULL);
+        char line[128];
+        fseek(file, book->fileOffset, SEEK_SET);
+        while (fgets(line, sizeof(line), file))
+        {
+            Reservation reservation;
+            int spot, cancelled;
+            size_t len = strlen(line);
+            METRIC_ADD(METRIC_BYTES_READ, len);
+            METRIC_ADD(METRIC_RECORDS_SCANNED, 1);
+            if (len == 0 || line[len - 1] != '\n')
+                break;  // Line still being written: read it next time
+            book->fileOffset += (long)len;
+            if (!parseReservationLine(line, &reservation, &spot, &cancelled))
+                continue;
+
+            if (reservation.id >= book->nextId)
+                book->nextId = reservation.id + 1;
+            if (cancelled)
+                dropReservation(book, spot, reservation.id);
+            else if (reservation.end > now)
+                addReservation(book, spot, &reservation);
+        }
+    }
+    fclose(file);
+}
+
+/**
+ * Checks whether a walk-in car may take a free bay now
+ *
+ * A bay is held from RESERVATION_HOLD_MINUTES before a booking starts
+ * until it ends, except for the car it is booked for.
+ * Call with book->lock held.
+ *
+ * @param book Reservation book
+ * @param spot Spot number
+ * @param plate Plate of the arriving car
+ * @param now Arrival time
+ * @return 1 if the bay is held for another car, 0 otherwise
+ */
+int spotHeld(const ReservationBook *book, int spot, const char *plate, time_t now)
+{
+    const BayReservations *bay = bayReservations(book, spot);
+    time_t until = now + RESERVATION_HOLD_MINUTES * 60;
+    for (int i = findReservation(bay, now); i < bay->count && bay->items[i].start < until; i++)
+    {
+        if (plate == NULL || stricmp(bay->items[i].plate, plate) != 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Picks a bay for an arriving car
+ *
+ * A car with a booking that is running (or starts within the hold time)
+ * gets its booked bay; anyone else gets the lowest free bay that is not
+ * held. Call with book->lock held.
+ *
+ * @param book Reservation book
+ * @param spots Current spot state
+ * @param plate Plate of the arriving car
+ * @param now Arrival time
+ * @return Spot number, 0 if every free bay is held
+ */
+int allocateSpot(const ReservationBook *book, const SpotTable *spots, const char *plate, time_t now)
+{
+    time_t until = now + RESERVATION_HOLD_MINUTES * 60;
+    for (int spot = nextFreeSpot(spots, 0); spot != 0; spot = nextFreeSpot(spots, spot))
+    {
+        const BayReservations *bay = bayReservations(book, spot);
+        int next = findReservation(bay, now);
+        if (next < bay->count && bay->items[next].start < until &&
+            stricmp(bay->items[next].plate, plate) == 0)
+            return spot;
+    }
+    for (int spot = nextFreeSpot(spots, 0); spot != 0; spot = nextFreeSpot(spots, spot))
+    {
+        if (!spotHeld(book, spot, plate, now))
+            return spot;
+    }
+    return 0;
+}
+
+/**
+ * Lists the bays that are free for a whole time window
+ *
+ * A bay qualifies when no booking overlaps the window and, if the window
+ * starts within the hold time, no car is parked in it now (a parked
+ * car's departure is unknown). Call with book->lock held.
+ *
+ * @param book Reservation book
+ * @param spots Current spot state
+ * @param level Level to search, 0 for all levels
+ * @param from Start of the window
+ * @param to End of the window (exclusive)
+ * @param now Current time
+ * @param out Receives the free spot numbers (PARKING_SPOTS entries)
+ * @return Number of free bays
+ */
+int findAvailableSpots(const ReservationBook *book, const SpotTable *spots, int level,
+                       time_t from, time_t to, time_t now, int out[])
+{
+    int count = 0;
+    int parkedMatters = from < now + RESERVATION_HOLD_MINUTES * 60;
+    for (int spot = 1; spot <= spots->count; spot++)
+    {
+        if (level && spotLevel(spot) != level)
+            continue;
+        if (parkedMatters && spotOccupied(spots, spot))
+            continue;
+        if (reservationOverlap(bayReservations(book, spot), from, to) == NULL)
+            out[count++] = spot;
+    }
+    return count;
+}
+
+/**
+ * Appends a line to the reservation file and syncs it
+ *
+ * @param reservation Booking
+ * @param spot Spot number
+ * @param state "booked" or "cancelled"
+ * @return 1 on success, 0 if the file could not be written
+ */
+int writeReservation(const Reservation *reservation, int spot, const char *state)
+{
+    FILE *file = openDataFile(FILENAME_RESERVATIONS, "a");
+    if (file == NULL)
+        return 0;
+    int len = fprintf(file, "%d,%s,%d,%lld,%lld,%s\n", reservation->id, reservation->plate, spot,
+                      (long long)reservation->start, (long long)reservation->end, state);
+    int ok = len > 0 && syncFile(file);
+    METRIC_ADD(METRIC_BYTES_WRITTEN, len);
+    return fclose(file) == 0 && ok;
+}
+
+/**
+ * Books a bay for a future time window
+ *
+ * @param plate Car to hold the bay for
+ * @param spot Spot to book, 0 for any free bay (on the level, if given)
+ * @param level Level for spot 0, 0 for any level
+ * @param from Start of the window
+ * @param to End of the window (exclusive)
+ * @param booked Receives the booking, including its number
+ * @param bookedSpot Receives the booked spot
+ * @return OP_OK or the reason the booking was rejected
+ */
+OpStatus reserveSpot(const char *plate, int spot, int level, time_t from, time_t to,
+                     Reservation *booked, int *bookedSpot)
+{
+    ReservationBook *book = &currentFacility->reservations;
+    time_t now = time(NULL);
+    if (strlen(plate) == 0)
+        return OP_EMPTY_PLATE;
+    if (spot < 0 || spot > PARKING_SPOTS || level < 0 || level > PARKING_LEVELS)
+        return OP_INVALID_SPOT;
+    if (from < now || to <= from)
+        return OP_INVALID_TIME;
+
+    SpotTable spots;
+    if (!loadSpotTable(&spots))
+    {
+        freeSpotTable(&spots);
+        return OP_IO_ERROR;
+    }
+
+    mutexLock(&book->lock);
+    refreshReservations(book);
+    int freeSpots[PARKING_SPOTS];
+    int count = findAvailableSpots(book, &spots, spot ? spotLevel(spot) : level,
+                                   from, to, now, freeSpots);
+    freeSpotTable(&spots);
+    int chosen = 0;
+    for (int i = 0; i < count && !chosen; i++)
+    {
+        if (spot == 0 || freeSpots[i] == spot)
+            chosen = freeSpots[i];
+    }
+
+    OpStatus status = OP_OK;
+    if (!chosen)
+        status = spot ? OP_RESERVED : OP_NO_VACANCY;
+    else
+    {
+        booked->id = book->nextId;
+        snprintf(booked->plate, sizeof(booked->plate), "%s", plate);
+        booked->start = from;
+        booked->end = to;
+        *bookedSpot = chosen;
+        if (!writeReservation(booked, chosen, "booked"))
+            status = OP_IO_ERROR;
+        else
+            refreshReservations(book);  // Picks up the new line
+    }
+    mutexUnlock(&book->lock);
+    return status;
+}
+
+/**
+ * Cancels a booking
+ *
+ * @param id Booking number
+ * @return OP_OK, OP_NO_RESERVATION or OP_IO_ERROR
+ */
+OpStatus cancelReservation(int id)
+{
+    ReservationBook *book = &currentFacility->reservations;
+    mutexLock(&book->lock);
+    refreshReservations(book);
+    OpStatus status = OP_NO_RESERVATION;
+    for (int spot = 1; spot <= PARKING_SPOTS && status == OP_NO_RESERVATION; spot++)
+    {
+        const BayReservations *bay = bayReservations(book, spot);
+        for (int i = 0; i < bay->count; i++)
+        {
+            if (bay->items[i].id != id)
+                continue;
+            Reservation cancelled = bay->items[i];
+            status = writeReservation(&cancelled, spot, "cancelled") ? OP_OK : OP_IO_ERROR;
+            if (status == OP_OK)
+                refreshReservations(book);
+            break;
+        }
+    }
+    mutexUnlock(&book->lock);
+    return status;
+}
+
+/**
+ * Parks a car: validates the record and commits the entry
+ *
+ * Shared by the Add Car screen and the "park" command.
+ *
+ * @param car Owner details, plate and requested spot (0 = allocate one);
+ *            spot, entry/exit time and fee are filled in
+ * @param now Entry time
+ * @return OP_OK or the reason the entry was rejected
+ */
+OpStatus parkCar(CarRecord *car, time_t now)
+{
+    ReservationBook *book = &currentFacility->reservations;
+    METRIC_START(start);
+    OpStatus valid = validateCarFields(car);
+    if (valid != OP_OK)
+        return valid;
+
+    SpotTable spots;
+    if (!loadSpotTable(&spots))
+    {
+        freeSpotTable(&spots);
+        return OP_IO_ERROR;
+    }
+    if (findParkedSpot(&spots, car->plate) != 0)
+    {
+        freeSpotTable(&spots);
+        return OP_ALREADY_PARKED;
+    }
+    int spotFree = car->spot >= 1 && car->spot <= spots.count && !spotOccupied(&spots, car->spot);
+
+    // Honour bookings: a held bay only goes to the car it is booked for
+    mutexLock(&book->lock);
+    refreshReservations(book);
+    int held = spotFree && spotHeld(book, car->spot, car->plate, now);
+    int allocated = car->spot == 0;
+    if (allocated)
+    {
+        car->spot = allocateSpot(book, &spots, car->plate, now);
+        spotFree = car->spot != 0;
+    }
+    mutexUnlock(&book->lock);
+    freeSpotTable(&spots);
+    if (car->spot == 0)
+        return OP_NO_VACANCY;
+    if (!spotFree)
+        return OP_INVALID_SPOT;
+    if (held)
+        return OP_RESERVED;
+
+    // Update parking spots and history through the group commit writer
+    JournalEvent event;
+    car->entry_time = now;
+    car->exit_time = 0;
+    car->fee = 0.0;
+    event.type = JOURNAL_ENTRY;
+    event.record = *car;
+
+    CommitStatus status = commitJournalEvent(&event);
+    METRIC_OBSERVE(METRIC_PARK, start);  // Rejected requests are not timed
+    if (status == COMMIT_CONFLICT && allocated)
+    {
+        car->spot = 0;  // Another gate took the picked bay first: pick again
+        return parkCar(car, now);
+    }
+    if (status == COMMIT_CONFLICT)
+        return OP_INVALID_SPOT;  // Spot was just taken at another gate
+    return status == COMMIT_OK ? OP_OK : OP_IO_ERROR;
+}
+
+/**
+ * Releases a parked car: computes the fee and commits the exit
+ *
+ * Shared by the Remove Car screen and the "leave" command.
+ *
+ * @param plate License plate (case-insensitive)
+ * @param exitTime Exit time
+ * @param receipt Receives plate, spot, entry/exit time and fee
+ * @return OP_OK, OP_NOT_PARKED or OP_IO_ERROR
+ */
+OpStatus leaveCar(const char *plate, time_t exitTime, CarRecord *receipt)
+{
+    METRIC_START(start);
+    if (strlen(plate) == 0)
+        return OP_EMPTY_PLATE;
+
+    SpotTable spots;
+    if (!loadSpotTable(&spots))
+    {
+        freeSpotTable(&spots);
+        return OP_IO_ERROR;
+    }
+
+    int spot = findParkedSpot(&spots, plate);
+    if (spot != 0)
+    {
+        // Use the plate as stored at entry so the history row matches
+        strcpy(receipt->plate, spots.plates[spot - 1]);
+        receipt->spot = spot;
+        receipt->entry_time = spots.entryTimes[spot - 1];
+    }
+    freeSpotTable(&spots);
+    if (spot == 0)
+        return OP_NOT_PARKED;
+
+    receipt->exit_time = exitTime;
+    receipt->fee = (exitTime - receipt->entry_time) * RATE_PER_SECOND;
+
+    // Free the spot and close the history row through the group commit writer
+    JournalEvent event;
+    event.type = JOURNAL_EXIT;
+    event.record = *receipt;
+
+    CommitStatus status = commitJournalEvent(&event);
+    METRIC_OBSERVE(METRIC_LEAVE, start);  // Rejected requests are not timed
+    if (status == COMMIT_CONFLICT)
+        return OP_NOT_PARKED;  // Car already left at another gate
+    return status == COMMIT_OK ? OP_OK : OP_IO_ERROR;
+}
+
+/**
+ * Scans the parking history for one owner or one plate
+ *
+ * By name: counts the owner's entries and collects the distinct plates.
+ * By plate: counts the plate's entries and collects the distinct owners.
+ * Both comparisons are case-insensitive.
+ *
+ * @param field SEARCH_BY_NAME or SEARCH_BY_PLATE
+ * @param key Name or plate to look for
+ * @param result Receives the totals and up to SEARCH_MAX_MATCHES values
+ * @return 1 on success, 0 if there is no history file
+ */
+int scanHistory(SearchField field, const char *key, SearchResult *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    FILE *file = openDataFile(FILENAME_HISTORY, "r");
+    if (file == NULL)
+        return 0;
+
+    METRIC_START(start);
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        CarRecord record;
+        METRIC_ADD(METRIC_BYTES_READ, strlen(line));
+        METRIC_ADD(METRIC_RECORDS_SCANNED, 1);
+        sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld",
+               record.name, record.plate, record.phone,
+               record.address, &record.spot, &record.entry_time, &record.exit_time);
+
+        const char *matched = field == SEARCH_BY_NAME ? record.name : record.plate;
+        const char *other = field == SEARCH_BY_NAME ? record.plate : record.name;
+        if (stricmp(matched, key) == 0)
+            addSearchMatch(result, other);
+    }
+    fclose(file);
+    METRIC_OBSERVE(METRIC_SEARCH, start);
+    return 1;
+}
+
+/**
+ * Reads how far the history has been written, for the search cache
+ *
+ * Call with the history lock held. Takes the lock file briefly, so the
+ * write count and the size belong together.
+ *
+ * @param writes Receives HistoryMarker.writes
+ * @param size Receives the history file size
+ * @return 1 on success, 0 if the lock file could not be locked
+ */
+int readHistoryState(unsigned long *writes, long *size)
+{
+    int locked = lockHistoryFile();
+    *writes = currentFacility->marker.writes;
+    *size = historyFileSize();
+    unlockHistoryFile();
+    return locked;
+}
+
+/**
+ * Searches the parking history for one owner or one plate, using the cache
+ *
+ * Same results as scanHistory(). Repeat searches are answered from
+ * memory as long as no process has written the history since, other
+ * than this process's own writes.
+ *
+ * @param field SEARCH_BY_NAME or SEARCH_BY_PLATE
+ * @param key Name or plate to look for
+ * @param result Receives the totals and up to SEARCH_MAX_MATCHES values
+ * @return 1 on success, 0 if there is no history file
+ */
+int searchHistory(SearchField field, const char *key, SearchResult *result)
+{
+    SearchCache *cache = &currentFacility->searchCache;
+    unsigned long writes, writesAfter;
+    long size, sizeAfter;
+    mutexLock(&cache->lock);
+    int known = readHistoryState(&writes, &size);
+    if (!known || size != cache->historySize || writes != cache->writes)
+        clearSearchCache(known ? size : -1);  // Changed by another process
+
+    for (int i = 0; known && i < SEARCH_CACHE_SIZE; i++)
+    {
+        SearchCacheEntry *entry = &cache->entries[i];
+        if (entry->used && entry->field == field && stricmp(entry->key, key) == 0)
+        {
+            *result = entry->result;
+            entry->lastUsed = ++cache->clock;
+            mutexUnlock(&cache->lock);
+            METRIC_ADD(METRIC_SEARCH_CACHE_HITS, 1);
+            return 1;
+        }
+    }
+    mutexUnlock(&cache->lock);
+
+    // Scan without the lock so gates are not held up by a long search
+    METRIC_ADD(METRIC_SEARCH_CACHE_MISSES, 1);
+    if (!scanHistory(field, key, result))
+        return 0;
+
+    mutexLock(&cache->lock);
+    if (readHistoryState(&writesAfter, &sizeAfter) && writesAfter == writes && sizeAfter == size &&
+        cache->historySize == size && cache->writes == writes && strlen(key) < sizeof(cache->entries[0].key))
+    {
+        // File unchanged during the scan: keep the result, replacing the least recently used
+        SearchCacheEntry *slot = &cache->entries[0];
+        for (int i = 0; i < SEARCH_CACHE_SIZE && slot->used; i++)
+        {
+            if (!cache->entries[i].used || cache->entries[i].lastUsed < slot->lastUsed)
+                slot = &cache->entries[i];
+        }
+        slot->used = 1;
+        slot->field = field;
+        strcpy(slot->key, key);
+        slot->result = *result;
+        slot->lastUsed = ++cache->clock;
+    }
+    mutexUnlock(&cache->lock);
+    return 1;
+}
+
+/**
+ * Normalizes a plate for the index: upper case, letters and digits only
+ *
+ * @param plate Plate as typed or read
+ * @param key Receives the normalized key
+ * @param size Size of key
+ * @return Length of the key
+ */
+int normalizePlate(const char *plate, char *key, int size)
+{
+    int len = 0;
+    for (const unsigned char *p = (const unsigned char *)plate; *p && len < size - 1; p++)
+    {
+        if (isalnum(*p))
+            key[len++] = (char)toupper(*p);
+    }
+    key[len] = '\0';
+    return len;
+}
+
+/**
+ * Cost of reading character b where character a was written
+ *
+ * @param a Character of the indexed plate
+ * @param b Character of the query
+ * @return 0 if equal, PLATE_CONFUSABLE_COST for look-alikes, else PLATE_EDIT_COST
+ */
+int plateSubstitutionCost(char a, char b)
+{
+    static const char *confusables[] = {"O0", "I1", "B8", "S5", "Z2"};
+    if (a == b)
+        return 0;
+    for (int i = 0; i < 5; i++)
+    {
+        if ((a == confusables[i][0] && b == confusables[i][1]) ||
+            (a == confusables[i][1] && b == confusables[i][0]))
+            return PLATE_CONFUSABLE_COST;
+    }
+    return PLATE_EDIT_COST;
+}
+
+/**
+ * Adds a trie node
+ *
+ * @param index Plate index
+ * @param symbol Edge character
+ * @return Node id, or -1 if out of memory
+ */
+int plateIndexNewNode(PlateIndex *index, char symbol)
+{
+    if (index->nodeCount == index->nodeCapacity)
+    {
+        int capacity = index->nodeCapacity ? index->nodeCapacity * 2 : 4096;
+        PlateTrieNode *grown = realloc(index->nodes, capacity * sizeof(PlateTrieNode));
+        if (grown == NULL)
+            return -1;
+        index->nodes = grown;
+        index->nodeCapacity = capacity;
+    }
+    PlateTrieNode *node = &index->nodes[index->nodeCount];
+    node->symbol = symbol;
+    node->firstChild = node->nextSibling = node->plate = -1;
+    return index->nodeCount++;
+}
+
+/**
+ * Finds a plate in the index, adding it if it is new
+ *
+ * @param index Plate index
+ * @param plate Plate as written
+ * @return Plate id, or -1 if the plate has no letters/digits or memory ran out
+ */
+int plateIndexAdd(PlateIndex *index, const char *plate)
+{
+    char key[20];
+    if (normalizePlate(plate, key, sizeof(key)) == 0)
+        return -1;
+    if (index->nodeCount == 0 && plateIndexNewNode(index, 0) < 0)
+        return -1;
+
+    int node = 0;
+    for (const char *p = key; *p; p++)
+    {
+        int child = index->nodes[node].firstChild;
+        while (child >= 0 && index->nodes[child].symbol != *p)
+            child = index->nodes[child].nextSibling;
+        if (child < 0)
+        {
+            child = plateIndexNewNode(index, *p);
+            if (child < 0)
+                return -1;
+            index->nodes[child].nextSibling = index->nodes[node].firstChild;
+            index->nodes[node].firstChild = child;
+        }
+        node = child;
+    }
+
+    if (index->nodes[node].plate >= 0)
+        return index->nodes[node].plate;
+
+    if (index->plateCount == index->plateCapacity)
+    {
+        int capacity = index->plateCapacity ? index->plateCapacity * 2 : 1024;
+        PlateEntry *grown = realloc(index->plates, capacity * sizeof(PlateEntry));
+        if (grown == NULL)
+            return -1;
+        index->plates = grown;
+        index->plateCapacity = capacity;
+    }
+    PlateEntry *entry = &index->plates[index->plateCount];
+    snprintf(entry->plate, sizeof(entry->plate), "%s", plate);
+    entry->spot = 0;
+    entry->visits = 0;
+    index->nodes[node].plate = index->plateCount;
+    return index->plateCount++;
+}
+
+/**
+ * Reads complete history rows into the plate index from the current
+ * position, remembering the offset of every PLATE_INDEX_MARK_ROWS-th row
+ *
+ * @param index Plate index
+ * @param file History file, positioned at the start of row index->historyRows
+ * @param untilRow Only count rows up to this one again (plates are already
+ *                 indexed), -1 to index every row to the end of file
+ */
+void readPlateIndexRows(PlateIndex *index, FILE *file, long untilRow)
+{
+    char line[256];
+    long offset = ftell(file);
+    while ((untilRow < 0 || index->historyRows < untilRow) && fgets(line, sizeof(line), file))
+    {
+        size_t len = strlen(line);
+        if (line[len - 1] != '\n')
+            break;  // Torn last row
+        if (index->historyRows == (long)index->markCount * PLATE_INDEX_MARK_ROWS)
+        {
+            if (index->markCount == index->markCapacity)
+            {
+                int capacity = index->markCapacity ? index->markCapacity * 2 : 64;
+                long *grown = realloc(index->marks, capacity * sizeof(long));
+                if (grown != NULL)
+                {
+                    index->marks = grown;
+                    index->markCapacity = capacity;
+                }
+            }
+            if (index->markCount < index->markCapacity)
+                index->marks[index->markCount++] = offset;
+        }
+        index->historyRows++;
+        offset = ftell(file);
+        METRIC_ADD(METRIC_BYTES_READ, len);
+        METRIC_ADD(METRIC_RECORDS_SCANNED, 1);
+        if (untilRow >= 0)
+            continue;
+
+        char name[50], plate[20];
+        if (sscanf(line, "%49[^,],%19[^,]", name, plate) != 2)
+            continue;
+        int id = plateIndexAdd(index, plate);
+        if (id >= 0)
+            index->plates[id].visits++;
+    }
+    index->historyOffset = offset;
+}
+
+/**
+ * Brings the plate index up to date with the data files
+ *
+ * The history marker in the lock file tells the lowest offset written
+ * by any process since the last refresh. Appended rows are indexed
+ * from the last offset. Closing a session rewrites rows in place and
+ * shifts those after it, but never adds, drops or reorders rows, so a
+ * change before the last offset is handled by counting the already
+ * indexed rows again from the remembered row offset before the change.
+ * A replaced history file, or more writes than the marker remembers,
+ * is indexed again from scratch. The history is read with the lock
+ * file held, so no row is read half rewritten. Parked flags are always
+ * reloaded from the spots file.
+ *
+ * @param index Plate index
+ */
+void refreshPlateIndex(PlateIndex *index)
+{
+    METRIC_START(start);
+    mutexLock(&currentFacility->searchCache.lock);
+    int locked = lockHistoryFile();
+    const HistoryMarker *marker = &currentFacility->marker;
+    FILE *file = openDataFile(FILENAME_HISTORY, "r");
+    if (file != NULL)
+    {
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        long changedFrom = LONG_MAX;
+        if (!locked || size < index->historyOffset || index->generation != marker->generation ||
+            marker->writes - index->writes > HISTORY_MARKER_SLOTS)
+            changedFrom = -1;
+        for (unsigned long w = index->writes + 1; changedFrom >= 0 && w - 1 != marker->writes; w++)
+        {
+            if (marker->changedFrom[w % HISTORY_MARKER_SLOTS] < changedFrom)
+                changedFrom = marker->changedFrom[w % HISTORY_MARKER_SLOTS];
+        }
+
+        if (changedFrom < 0)
+        {
+            // History was rewritten (shorter, or compacted), or too much happened: start over
+            int *parked = index->parked;
+            int parkedCapacity = index->parkedCapacity;
+            free(index->nodes);
+            free(index->plates);
+            free(index->marks);
+            memset(index, 0, sizeof(*index));
+            index->parked = parked;  // Reloaded below anyway
+            index->parkedCapacity = parkedCapacity;
+            index->generation = marker->generation;
+        }
+        else if (changedFrom < index->historyOffset)
+        {
+            // Rows from the change on moved: find where the indexed ones end now
+            long indexedRows = index->historyRows;
+            int mark = index->markCount - 1;
+            while (mark > 0 && index->marks[mark] > changedFrom)
+                mark--;
+            fseek(file, index->marks[mark], SEEK_SET);
+            index->markCount = mark;  // Recorded again while counting
+            index->historyRows = (long)mark * PLATE_INDEX_MARK_ROWS;
+            readPlateIndexRows(index, file, indexedRows);
+        }
+        index->writes = marker->writes;
+
+        if (size > index->historyOffset)
+        {
+            fseek(file, index->historyOffset, SEEK_SET);
+            readPlateIndexRows(index, file, -1);
+        }
+        fclose(file);
+    }
+    unlockHistoryFile();
+    mutexUnlock(&currentFacility->searchCache.lock);
+
+    SpotTable spots;
+    for (int i = 0; i < index->parkedCount; i++)
+        index->plates[index->parked[i]].spot = 0;
+    index->parkedCount = 0;
+    if (loadSpotTable(&spots))
+    {
+        // Sized by the cars parked, not the bays there are
+        int occupied = countOccupiedSpots(&spots);
+        int *grown = occupied > index->parkedCapacity ? realloc(index->parked, occupied * sizeof(int)) : NULL;
+        if (grown != NULL)
+        {
+            index->parked = grown;
+            index->parkedCapacity = occupied;
+        }
+
+        for (int spot = nextOccupiedSpot(&spots, 0); spot != 0; spot = nextOccupiedSpot(&spots, spot))
+        {
+            if (index->parkedCount == index->parkedCapacity)
+                break;  // Out of memory
+            int id = plateIndexAdd(index, spots.plates[spot - 1]);
+            if (id < 0)
+                continue;
+            strcpy(index->plates[id].plate, spots.plates[spot - 1]);  // leaveCar needs the parked spelling
+            index->plates[id].spot = spot;
+            index->parked[index->parkedCount++] = id;
+        }
+    }
+    freeSpotTable(&spots);
+    setGauge(METRIC_PLATES_INDEXED, index->plateCount);
+    METRIC_OBSERVE(METRIC_INDEX_REFRESH, start);
+}
+
+/**
+ * Adds a plate to ranked candidates if it beats the current ones
+ *
+ * Lower cost ranks first, then parked plates, then plates seen more often.
+ *
+ * @param index Plate index
+ * @param out Candidates so far
+ * @param id Plate id
+ * @param cost Match cost
+ * @param prefix Matched as a prefix
+ */
+void offerPlateCandidate(const PlateIndex *index, PlateCandidates *out, int id, int cost, int prefix)
+{
+    const PlateEntry *entry = &index->plates[id];
+
+    // Same plate found both ways: keep the cheaper match
+    for (int i = 0; i < out->count; i++)
+    {
+        if (strcmp(out->matches[i].plate, entry->plate) != 0)
+            continue;
+        if (out->matches[i].cost <= cost)
+            return;
+        memmove(&out->matches[i], &out->matches[i + 1], (out->count - i - 1) * sizeof(PlateMatch));
+        out->count--;
+        break;
+    }
+
+    int pos = out->count;
+    while (pos > 0)
+    {
+        const PlateMatch *prev = &out->matches[pos - 1];
+        int prevParked = prev->spot != 0, parked = entry->spot != 0;
+        if (prev->cost != cost ? prev->cost < cost :
+            prevParked != parked ? prevParked > parked : prev->visits >= entry->visits)
+            break;
+        pos--;
+    }
+    if (pos >= PLATE_MAX_CANDIDATES)
+        return;
+
+    int last = out->count < PLATE_MAX_CANDIDATES ? out->count : PLATE_MAX_CANDIDATES - 1;
+    memmove(&out->matches[pos + 1], &out->matches[pos], (last - pos) * sizeof(PlateMatch));
+    PlateMatch *match = &out->matches[pos];
+    strcpy(match->plate, entry->plate);
+    match->spot = entry->spot;
+    match->visits = entry->visits;
+    match->cost = cost;
+    match->prefix = prefix;
+    if (out->count < PLATE_MAX_CANDIDATES)
+        out->count++;
+}
+
+/**
+ * Offers every plate below a trie node as a prefix match
+ *
+ * @param index Plate index
+ * @param node Trie node reached by the query
+ * @param depth Characters below the query so far
+ * @param parkedOnly Skip plates that are not parked
+ * @param out Candidates so far
+ */
+void collectPlatePrefix(const PlateIndex *index, int node, int depth, int parkedOnly, PlateCandidates *out)
+{
+    const PlateTrieNode *n = &index->nodes[node];
+    if (n->plate >= 0 && depth > 0 && (!parkedOnly || index->plates[n->plate].spot))
+        offerPlateCandidate(index, out, n->plate, PLATE_PREFIX_COST + depth, 1);
+    if (PLATE_PREFIX_COST + depth >= PLATE_MAX_COST)
+        return;  // Longer completions could not be suggested anyway
+    for (int child = n->firstChild; child >= 0; child = index->nodes[child].nextSibling)
+        collectPlatePrefix(index, child, depth + 1, parkedOnly, out);
+}
+
+/**
+ * Walks the trie computing one weighted edit-distance row per level
+ *
+ * Subtrees whose best row entry already exceeds PLATE_MAX_COST are
+ * skipped, so only a small part of the trie is visited.
+ *
+ * @param index Plate index
+ * @param node Current trie node
+ * @param query Normalized query
+ * @param len Query length
+ * @param row Edit-distance row of the parent node
+ * @param parkedOnly Skip plates that are not parked
+ * @param out Candidates so far
+ */
+void searchPlateTrie(const PlateIndex *index, int node, const char *query, int len,
+                     const int *row, int parkedOnly, PlateCandidates *out)
+{
+    for (int child = index->nodes[node].firstChild; child >= 0; child = index->nodes[child].nextSibling)
+    {
+        const PlateTrieNode *n = &index->nodes[child];
+        int next[20];
+        int best = next[0] = row[0] + PLATE_EDIT_COST;
+        for (int j = 1; j <= len; j++)
+        {
+            int cost = row[j - 1] + plateSubstitutionCost(n->symbol, query[j - 1]);
+            if (row[j] + PLATE_EDIT_COST < cost)
+                cost = row[j] + PLATE_EDIT_COST;           // Extra character in the plate
+            if (next[j - 1] + PLATE_EDIT_COST < cost)
+                cost = next[j - 1] + PLATE_EDIT_COST;      // Extra character in the query
+            next[j] = cost;
+            if (cost < best)
+                best = cost;
+        }
+
+        if (n->plate >= 0 && next[len] <= PLATE_MAX_COST &&
+            (!parkedOnly || index->plates[n->plate].spot))
+            offerPlateCandidate(index, out, n->plate, next[len], 0);
+        if (best <= PLATE_MAX_COST)
+            searchPlateTrie(index, child, query, len, next, parkedOnly, out);
+    }
+}
+
+/**
+ * Finds the plates closest to a (possibly misread) plate
+ *
+ * Combines plates that start with the query with plates within a
+ * weighted edit distance, where look-alike characters are cheap to
+ * confuse. Case, spaces and dashes are ignored.
+ *
+ * @param index Plate index, refreshed by the caller
+ * @param query Plate as typed or read by a camera
+ * @param parkedOnly Only suggest plates that are parked now
+ * @param out Receives up to PLATE_MAX_CANDIDATES plates, best first
+ */
+void lookupPlates(const PlateIndex *index, const char *query, int parkedOnly, PlateCandidates *out)
+{
+    char key[20];
+    int len = normalizePlate(query, key, sizeof(key));
+    out->count = 0;
+    if (len == 0 || index->nodeCount == 0)
+        return;
+
+    METRIC_START(start);
+
+    // Prefix matches: walk down the query, then list the subtree
+    int node = 0;
+    for (int i = 0; i < len && node >= 0; i++)
+    {
+        int child = index->nodes[node].firstChild;
+        while (child >= 0 && index->nodes[child].symbol != key[i])
+            child = index->nodes[child].nextSibling;
+        node = child;
+    }
+    if (node >= 0)
+        collectPlatePrefix(index, node, 0, parkedOnly, out);
+
+    int row[20];
+    for (int j = 0; j <= len; j++)
+        row[j] = j * PLATE_EDIT_COST;
+    searchPlateTrie(index, 0, key, len, row, parkedOnly, out);
+    METRIC_OBSERVE(METRIC_PLATE_LOOKUP, start);
+}
+
+/**
+ * Appends bytes to a growable buffer
+ *
+ * @param buffer Buffer to append to
+ * @param data Bytes to append
+ * @param len Number of bytes
+ * @return 1 on success, 0 if out of memory
+ */
+int bufferAppend(ByteBuffer *buffer, const void *data, size_t len)
+{
+    if (buffer->len + len > buffer->cap)
+    {
+        size_t cap = buffer->cap ? buffer->cap * 2 : 4096;
+        while (cap < buffer->len + len)
+            cap *= 2;
+        unsigned char *grown = realloc(buffer->data, cap);
+        if (grown == NULL)
+            return 0;
+        buffer->data = grown;
+        buffer->cap = cap;
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return 1;
+}
+
+/**
+ * Appends an unsigned LEB128 varint
+ *
+ * @param buffer Buffer to append to
+ * @param value Value to encode
+ * @return 1 on success, 0 if out of memory
+ */
+int bufferPutVarint(ByteBuffer *buffer, uint64_t value)
+{
+    unsigned char bytes[10];
+    int n = 0;
+    do
+    {
+        bytes[n] = value & 0x7F;
+        value >>= 7;
+        if (value)
+            bytes[n] |= 0x80;
+        n++;
+    } while (value);
+    return bufferAppend(buffer, bytes, n);
+}
+
+/**
+ * Appends a little-endian 32-bit value
+ *
+ * @param buffer Buffer to append to
+ * @param value Value to encode
+ * @return 1 on success, 0 if out of memory
+ */
+int bufferPutU32(ByteBuffer *buffer, uint32_t value)
+{
+    unsigned char bytes[4] = {value & 0xFF, (value >> 8) & 0xFF,
+                              (value >> 16) & 0xFF, (value >> 24) & 0xFF};
+    return bufferAppend(buffer, bytes, 4);
+}
+
+/**
+ * Appends a little-endian 64-bit value
+ *
+ * @param buffer Buffer to append to
+ * @param value Value to encode
+ * @return 1 on success, 0 if out of memory
+ */
+int bufferPutU64(ByteBuffer *buffer, uint64_t value)
+{
+    return bufferPutU32(buffer, (uint32_t)value) && bufferPutU32(buffer, (uint32_t)(value >> 32));
+}
+
+/**
+ * Reads a little-endian 32-bit value
+ *
+ * @param bytes Encoded bytes
+ * @return Decoded value
+ */
+uint32_t readU32(const unsigned char *bytes)
+{
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+/**
+ * Reads a little-endian 64-bit value
+ *
+ * @param bytes Encoded bytes
+ * @return Decoded value
+ */
+uint64_t readU64(const unsigned char *bytes)
+{
+    return readU32(bytes) | ((uint64_t)readU32(bytes + 4) << 32);
+}
+
+/**
+ * Decodes a chunk of varints into an array
+ *
+ * @param data Encoded chunk
+ * @param len Chunk length in bytes
+ * @param out Receives the values
+ * @param count Number of values to decode
+ * @return 1 on success, 0 if the chunk is truncated
+ */
+int decodeVarints(const unsigned char *data, size_t len, int64_t *out, int count)
+{
+    size_t pos = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t value = 0;
+        int shift = 0;
+        for (;;)
+        {
+            if (pos >= len || shift > 63)
+                return 0;
+            unsigned char byte = data[pos++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                break;
+            shift += 7;
+        }
+        out[i] = (int64_t)value;
+    }
+    return 1;
+}
+
+/**
+ * Finds or adds an owner in the export dictionary
+ *
+ * Names are matched case-insensitively, like the owner search.
+ *
+ * @param dict Owner dictionary
+ * @param name Owner name
+ * @return Owner id, or -1 if out of memory
+ */
+int ownerDictionaryId(OwnerDictionary *dict, const char *name)
+{
+    // FNV-1a over the case-folded name
+    uint32_t hash = 2166136261u;
+    for (const char *p = name; *p; p++)
+        hash = (hash ^ (unsigned char)tolower((unsigned char)*p)) * 16777619u;
+
+    if (dict->count * 2 >= dict->slotCount)
+    {
+        // Grow the hash table and re-insert existing ids
+        int slotCount = dict->slotCount ? dict->slotCount * 2 : 1024;
+        int *slots = malloc(slotCount * sizeof(int));
+        if (slots == NULL)
+            return -1;
+        for (int i = 0; i < slotCount; i++)
+            slots[i] = -1;
+        for (int id = 0; id < dict->count; id++)
+        {
+            uint32_t h = dict->hashes[id];
+            int slot = h & (slotCount - 1);
+            while (slots[slot] >= 0)
+                slot = (slot + 1) & (slotCount - 1);
+            slots[slot] = id;
+        }
+        free(dict->slots);
+        dict->slots = slots;
+        dict->slotCount = slotCount;
+    }
+
+    int slot = hash & (dict->slotCount - 1);
+    while (dict->slots[slot] >= 0)
+    {
+        int id = dict->slots[slot];
+        if (dict->hashes[id] == hash && stricmp(dict->names[id], name) == 0)
+            return id;
+        slot = (slot + 1) & (dict->slotCount - 1);
+    }
+
+    if (dict->count == dict->capacity)
+    {
+        int capacity = dict->capacity ? dict->capacity * 2 : 1024;
+        char **names = realloc(dict->names, capacity * sizeof(char *));
+        uint32_t *hashes = names ? realloc(dict->hashes, capacity * sizeof(uint32_t)) : NULL;
+        if (names)
+            dict->names = names;
+        if (hashes == NULL)
+            return -1;
+        dict->hashes = hashes;
+        dict->capacity = capacity;
+    }
+
+    dict->names[dict->count] = malloc(strlen(name) + 1);
+    if (dict->names[dict->count] == NULL)
+        return -1;
+    strcpy(dict->names[dict->count], name);
+    dict->hashes[dict->count] = hash;
+    dict->slots[slot] = dict->count;
+    return dict->count++;
+}
+
+/**
+ * Releases an owner dictionary
+ *
+ * @param dict Owner dictionary
+ */
+void freeOwnerDictionary(OwnerDictionary *dict)
+{
+    for (int i = 0; i < dict->count; i++)
+        free(dict->names[i]);
+    free(dict->names);
+    free(dict->hashes);
+    free(dict->slots);
+    memset(dict, 0, sizeof(*dict));
+}
+
+/**
+ * Encodes buffered rows as one row group and writes it
+ *
+ * Entry times are delta-encoded (zigzag, so out-of-order gates are
+ * fine), exit times are stored as dwell seconds and fees in paise; all
+ * values are varints. The group header also holds the earliest and
+ * latest exit time, so date-filtered reports can skip the group.
+ *
+ * @param file Column store being written
+ * @param rows Buffered rows
+ * @param count Number of rows
+ * @return 1 on success, 0 on failure
+ */
+int writeColumnGroup(FILE *file, const ColumnRow *rows, int count)
+{
+    ByteBuffer columns[COLUMN_COUNT];
+    ByteBuffer header = {0};
+    int ok = 1;
+    memset(columns, 0, sizeof(columns));
+
+    int64_t previous = 0, minExit = INT64_MAX, maxExit = INT64_MIN;
+    for (int i = 0; i < count && ok; i++)
+    {
+        int64_t delta = rows[i].entry_time - previous;
+        int64_t exitTime = rows[i].entry_time + rows[i].dwell;
+        previous = rows[i].entry_time;
+        minExit = exitTime < minExit ? exitTime : minExit;
+        maxExit = exitTime > maxExit ? exitTime : maxExit;
+        ok = bufferPutVarint(&columns[COL_ENTRY], ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)) &&
+             bufferPutVarint(&columns[COL_DWELL], rows[i].dwell) &&
+             bufferPutVarint(&columns[COL_SPOT], rows[i].spot) &&
+             bufferPutVarint(&columns[COL_FEE], rows[i].fee) &&
+             bufferPutVarint(&columns[COL_OWNER], rows[i].owner);
+    }
+
+    ok = ok && bufferPutU32(&header, count);
+    for (int c = 0; c < COLUMN_COUNT && ok; c++)
+        ok = bufferPutU32(&header, (uint32_t)columns[c].len);
+    ok = ok && bufferPutU64(&header, (uint64_t)minExit) && bufferPutU64(&header, (uint64_t)maxExit);
+    ok = ok && fwrite(header.data, 1, header.len, file) == header.len;
+    for (int c = 0; c < COLUMN_COUNT && ok; c++)
+        ok = fwrite(columns[c].data, 1, columns[c].len, file) == columns[c].len;
+
+    free(header.data);
+    for (int c = 0; c < COLUMN_COUNT; c++)
+        free(columns[c].data);
+    return ok;
+}
+
+/**
+ * Exports closed sessions from the history file to the column store
+ *
+ * The store is rebuilt from scratch into a temporary file and renamed
+ * into place, so reports never see a half-written store. Open sessions
+ * (exit_time == 0) are not exported. The header records the history
+ * size and write count as of the start, so a report can tell when the
+ * history has moved on.
+ *
+ * @param stats Receives the number of rows and owners exported
+ * @return 1 on success, 0 on failure
+ */
+int exportHistoryColumns(ColumnStoreHeader *stats)
+{
+    // Header is rewritten with the final totals once all groups are out
+    ColumnStoreHeader header = {0, INT64_MAX, INT64_MIN, 0, 0, 0};
+    unsigned long writes;
+    long size;
+    mutexLock(&currentFacility->searchCache.lock);
+    int known = readHistoryState(&writes, &size);
+    mutexUnlock(&currentFacility->searchCache.lock);
+    header.historySize = known ? size : -1;  // Never matches, so the next report exports again
+    header.historyWrites = writes;
+
+    FILE *history = openDataFile(FILENAME_HISTORY, "r");
+    if (history == NULL)
+        return 0;
+
+    FILE *out = openDataFile(FILENAME_COLUMNS ".tmp", "wb");
+    if (out == NULL)
+    {
+        fclose(history);
+        return 0;
+    }
+
+    unsigned char blank[COLUMN_HEADER_SIZE] = {0};
+    int ok = fwrite(blank, 1, sizeof(blank), out) == sizeof(blank);
+
+    OwnerDictionary owners = {0};
+    ColumnRow *rows = malloc(COLUMN_GROUP_ROWS * sizeof(ColumnRow));
+    int buffered = 0;
+    char line[256];
+    ok = ok && rows != NULL;
+
+    while (ok && fgets(line, sizeof(line), history))
+    {
+        CarRecord record;
+        METRIC_ADD(METRIC_BYTES_READ, strlen(line));
+        METRIC_ADD(METRIC_RECORDS_SCANNED, 1);
+        if (sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld,%lf",
+                   record.name, record.plate, record.phone,
+                   record.address, &record.spot, &record.entry_time,
+                   &record.exit_time, &record.fee) != 8 || record.exit_time == 0)
+            continue;
+
+        ColumnRow *row = &rows[buffered++];
+        row->entry_time = record.entry_time;
+        row->dwell = record.exit_time > record.entry_time ? record.exit_time - record.entry_time : 0;
+        row->spot = record.spot;
+        row->fee = (int64_t)llround(record.fee * 100.0);
+        row->owner = ownerDictionaryId(&owners, record.name);
+        ok = row->owner >= 0;
+
+        if (record.entry_time < header.minTime)
+            header.minTime = record.entry_time;
+        if (record.exit_time > header.maxTime)
+            header.maxTime = record.exit_time;
+        header.rows++;
+
+        if (buffered == COLUMN_GROUP_ROWS)
+        {
+            ok = ok && writeColumnGroup(out, rows, buffered);
+            buffered = 0;
+        }
+    }
+    if (ok && buffered > 0)
+        ok = writeColumnGroup(out, rows, buffered);
+    free(rows);
+    fclose(history);
+
+    // Final header: magic, row count, time range, history state
+    ByteBuffer head = {0};
+    ok = ok && bufferAppend(&head, COLUMN_MAGIC, 8) && bufferPutU64(&head, header.rows) &&
+         bufferPutU64(&head, (uint64_t)header.minTime) && bufferPutU64(&head, (uint64_t)header.maxTime) &&
+         bufferPutU64(&head, (uint64_t)header.historySize) && bufferPutU64(&head, header.historyWrites);
+    ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(head.data, 1, head.len, out) == head.len;
+    free(head.data);
+    ok = syncFile(out) && ok;
+    fclose(out);
+
+    // Owner dictionary: one name per line, line number = owner id
+    FILE *dictFile = ok ? openDataFile(FILENAME_OWNERS ".tmp", "w") : NULL;
+    ok = dictFile != NULL;
+    for (int i = 0; ok && i < owners.count; i++)
+        ok = fprintf(dictFile, "%s\n", owners.names[i]) > 0;
+    if (dictFile != NULL)
+    {
+        ok = syncFile(dictFile) && ok;
+        fclose(dictFile);
+    }
+    if (stats != NULL)
+    {
+        *stats = header;
+        stats->owners = owners.count;
+    }
+    freeOwnerDictionary(&owners);
+
+    if (ok)
+        ok = replaceDataFile(FILENAME_COLUMNS ".tmp", FILENAME_COLUMNS) &&
+             replaceDataFile(FILENAME_OWNERS ".tmp", FILENAME_OWNERS);
+    if (!ok)
+    {
+        removeDataFile(FILENAME_COLUMNS ".tmp");
+        removeDataFile(FILENAME_OWNERS ".tmp");
+    }
+    return ok;
+}
+
+/**
+ * Opens the column store and reads its header
+ *
+ * @param header Receives row count and time range
+ * @return Open file positioned at the first row group, or NULL
+ */
+FILE *openColumnStore(ColumnStoreHeader *header)
+{
+    unsigned char head[COLUMN_HEADER_SIZE];
+    FILE *file = openDataFile(FILENAME_COLUMNS, "rb");
+    if (file == NULL)
+        return NULL;
+    if (fread(head, 1, sizeof(head), file) != sizeof(head) || memcmp(head, COLUMN_MAGIC, 8) != 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+    header->rows = readU64(head + 8);
+    header->minTime = (int64_t)readU64(head + 16);
+    header->maxTime = (int64_t)readU64(head + 24);
+    header->historySize = (int64_t)readU64(head + 32);
+    header->historyWrites = readU64(head + 40);
+    header->owners = 0;
+    return file;
+}
+
+/**
+ * Tells whether the column store is missing or older than the history
+ *
+ * Any write to the history by any process since the export, including
+ * sessions closed in place, makes the store stale.
+ *
+ * @return 1 if the store has to be exported again, 0 if it is current
+ */
+int columnStoreStale()
+{
+    ColumnStoreHeader header;
+    FILE *file = openColumnStore(&header);
+    if (file == NULL)
+        return 1;
+    fclose(file);
+
+    unsigned long writes;
+    long size;
+    mutexLock(&currentFacility->searchCache.lock);
+    int known = readHistoryState(&writes, &size);
+    mutexUnlock(&currentFacility->searchCache.lock);
+    return !known || header.historyWrites != writes || header.historySize != size;
+}
+
+/**
+ * Reads the next row group with an exit time in a range, decoding only
+ * the requested columns
+ *
+ * Groups whose exit times all fall outside the range are skipped
+ * without being read, using the exit time range in their header.
+ *
+ * @param file Column store opened with openColumnStore()
+ * @param group Receives the decoded columns
+ * @param columns Bit mask of (1 << COL_...) values to decode
+ * @param from First exit time wanted
+ * @param to First exit time no longer wanted
+ * @return Rows in the group, 0 at end of store, -1 if the store is corrupt
+ */
+int readColumnGroup(FILE *file, ColumnGroup *group, unsigned columns, int64_t from, int64_t to)
+{
+    unsigned char head[4 * (COLUMN_COUNT + 1) + 16];
+    int rows;
+    size_t lengths[COLUMN_COUNT], total;
+    for (;;)
+    {
+        size_t got = fread(head, 1, sizeof(head), file);
+        if (got == 0)
+            return 0;
+        if (got != sizeof(head))
+            return -1;
+
+        rows = (int)readU32(head);
+        total = 0;
+        for (int c = 0; c < COLUMN_COUNT; c++)
+        {
+            lengths[c] = readU32(head + 4 * (c + 1));
+            total += lengths[c];
+        }
+        if (rows <= 0 || rows > COLUMN_GROUP_ROWS)
+            return -1;
+
+        int64_t minExit = (int64_t)readU64(head + 4 * (COLUMN_COUNT + 1));
+        int64_t maxExit = (int64_t)readU64(head + 4 * (COLUMN_COUNT + 1) + 8);
+        if (maxExit >= from && minExit < to)
+            break;
+        if (fseek(file, (long)total, SEEK_CUR) != 0)
+            return -1;
+    }
+
+    if (total > group->scratch.cap)
+    {
+        unsigned char *grown = realloc(group->scratch.data, total);
+        if (grown == NULL)
+            return -1;
+        group->scratch.data = grown;
+        group->scratch.cap = total;
+    }
+    if (fread(group->scratch.data, 1, total, file) != total)
+        return -1;
+
+    int64_t *targets[COLUMN_COUNT] = {group->entry, group->dwell, group->spot, group->fee, group->owner};
+    size_t offset = 0;
+    for (int c = 0; c < COLUMN_COUNT; c++)
+    {
+        if ((columns & (1u << c)) &&
+            !decodeVarints(group->scratch.data + offset, lengths[c], targets[c], rows))
+            return -1;
+        offset += lengths[c];
+    }
+
+    // Undo zigzag delta encoding of entry times
+    if (columns & (1u << COL_ENTRY))
+    {
+        int64_t previous = 0;
+        for (int i = 0; i < rows; i++)
+        {
+            uint64_t zigzag = (uint64_t)group->entry[i];
+            previous += (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            group->entry[i] = previous;
+        }
+    }
+    group->rows = rows;
+    return rows;
+}
+
+/**
+ * Offset of local time from UTC in seconds, taken once per report
+ *
+ * @return Seconds to add to a UTC timestamp to get local wall-clock time
+ */
+long localUtcOffset()
+{
+    time_t now = time(NULL);
+    struct tm utc = *gmtime(&now);
+    utc.tm_isdst = -1;
+    return (long)difftime(now, mktime(&utc));
+}
+
+/**
+ * Releases the arrays of a report
+ *
+ * @param totals Report aggregates
+ */
+void freeReportTotals(ReportTotals *totals)
+{
+    free(totals->sessions);
+    free(totals->revenue);
+    free(totals->seconds);
+    totals->sessions = totals->revenue = totals->seconds = NULL;
+}
+
+/**
+ * Runs a report over the column store
+ *
+ * Each row group is decoded into plain arrays and aggregated with
+ * tight branch-free loops over the whole group (filter mask first,
+ * then keyed sums), which the compiler can vectorize. Sessions are
+ * attributed to the local day/hour of their exit time. Row groups with
+ * no exit time in the range are skipped without being decoded.
+ *
+ * @param kind Report to run
+ * @param from First exit time included (0 = no lower bound)
+ * @param to First exit time excluded (0 = no upper bound)
+ * @param totals Receives the aggregates (caller frees with freeReportTotals)
+ * @return 1 on success, 0 if the store is missing or corrupt
+ */
+int runReport(ReportKind kind, time_t from, time_t to, ReportTotals *totals)
+{
+    ColumnStoreHeader header;
+    FILE *file = openColumnStore(&header);
+    if (file == NULL)
+        return 0;
+
+    memset(totals, 0, sizeof(*totals));
+    totals->utcOffset = localUtcOffset();
+    long lastDay = 0;
+    if (header.rows > 0)
+    {
+        totals->firstDay = (long)((header.minTime + totals->utcOffset) / 86400);
+        lastDay = (long)((header.maxTime + totals->utcOffset) / 86400);
+    }
+
+    switch (kind)
+    {
+    case REPORT_DAILY:
+        totals->keys = (int)(lastDay - totals->firstDay + 1);
+        break;
+    case REPORT_HOURLY:
+        totals->keys = 24;
+        break;
+    case REPORT_LEVEL:
+        totals->keys = PARKING_LEVELS + 1;
+        break;
+    case REPORT_DWELL:
+        totals->keys = DWELL_MAX_MINUTES + 1;
+        break;
+    case REPORT_TURNOVER:
+        totals->keys = PARKING_SPOTS + 1;
+        break;
+    }
+    if (totals->keys < 1)
+        totals->keys = 1;
+    totals->sessions = calloc(totals->keys, sizeof(int64_t));
+    totals->revenue = calloc(totals->keys, sizeof(int64_t));
+    totals->seconds = calloc(totals->keys, sizeof(int64_t));
+
+    ColumnGroup *group = calloc(1, sizeof(ColumnGroup));
+    int ok = totals->sessions && totals->revenue && totals->seconds && group;
+    unsigned columns = (1u << COL_ENTRY) | (1u << COL_DWELL) | (1u << COL_FEE);
+    if (kind == REPORT_LEVEL || kind == REPORT_TURNOVER)
+        columns |= 1u << COL_SPOT;
+
+    int rows = 0;
+    int64_t exitTime[COLUMN_GROUP_ROWS];
+    int64_t mask[COLUMN_GROUP_ROWS];
+    int32_t key[COLUMN_GROUP_ROWS];
+    int64_t lo = from ? (int64_t)from : INT64_MIN, hi = to ? (int64_t)to : INT64_MAX;
+
+    while (ok && (rows = readColumnGroup(file, group, columns, lo, hi)) > 0)
+    {
+        // Exit times and range filter as a 0/1 mask
+        for (int i = 0; i < rows; i++)
+        {
+            exitTime[i] = group->entry[i] + group->dwell[i];
+            mask[i] = (exitTime[i] >= lo) & (exitTime[i] < hi);
+        }
+
+        // Grouping key per row
+        switch (kind)
+        {
+        case REPORT_DAILY:
+            for (int i = 0; i < rows; i++)
+                key[i] = (int32_t)((exitTime[i] + totals->utcOffset) / 86400 - totals->firstDay);
+            break;
+        case REPORT_HOURLY:
+            for (int i = 0; i < rows; i++)
+                key[i] = (int32_t)(((exitTime[i] + totals->utcOffset) % 86400) / 3600);
+            break;
+        case REPORT_LEVEL:
+            for (int i = 0; i < rows; i++)
+                key[i] = (int32_t)((group->spot[i] - 1) / SPOTS_PER_LEVEL + 1);
+            break;
+        case REPORT_DWELL:
+            for (int i = 0; i < rows; i++)
+            {
+                int64_t minutes = group->dwell[i] / 60;
+                key[i] = (int32_t)(minutes < DWELL_MAX_MINUTES ? minutes : DWELL_MAX_MINUTES);
+            }
+            break;
+        case REPORT_TURNOVER:
+            for (int i = 0; i < rows; i++)
+                key[i] = (int32_t)group->spot[i];
+            break;
+        }
+
+        // Keyed sums; rows outside the range or with a bad key add zero
+        for (int i = 0; i < rows; i++)
+        {
+            int32_t k = key[i];
+            int64_t m = mask[i] & (k >= 0) & (k < totals->keys);
+            k = m ? k : 0;
+            totals->sessions[k] += m;
+            totals->revenue[k] += group->fee[i] * m;
+            totals->seconds[k] += group->dwell[i] * m;
+        }
+    }
+    if (rows < 0)
+        ok = 0;
+
+    for (int k = 0; ok && k < totals->keys; k++)
+    {
+        totals->totalSessions += totals->sessions[k];
+        totals->totalRevenue += totals->revenue[k];
+        totals->totalSeconds += totals->seconds[k];
+    }
+
+    if (group)
+        free(group->scratch.data);
+    free(group);
+    fclose(file);
+    if (!ok)
+        freeReportTotals(totals);
+    return ok;
+}
+
+/**
+ * Orders history records by owner, then plate, then entry time
+ *
+ * Owner and plate compare case-insensitively, like the searches.
+ *
+ * @param a First CarRecord
+ * @param b Second CarRecord
+ * @return Negative, zero or positive, as for qsort()
+ */
+int compareStatementRecords(const void *a, const void *b)
+{
+    const CarRecord *x = a, *y = b;
+    int order = stricmp(x->name, y->name);
+    if (order == 0)
+        order = stricmp(x->plate, y->plate);
+    if (order == 0)
+        order = (x->entry_time > y->entry_time) - (x->entry_time < y->entry_time);
+    return order;
+}
+
+/**
+ * Names the temporary file holding one sorted run
+ *
+ * @param name Receives the file name
+ * @param size Size of name
+ * @param run Run number
+ */
+void statementRunName(char *name, size_t size, int run)
+{
+    snprintf(name, size, FILENAME_STATEMENTS ".run%d.tmp", run);
+}
+
+/**
+ * Refills a run reader's buffer from its file
+ *
+ * @param reader Run reader
+ * @return 1 if a record is available, 0 at end of run
+ */
+int runReaderFill(RunReader *reader)
+{
+    if (reader->pos < reader->count)
+        return 1;
+    reader->count = reader->file ? (int)fread(reader->buffer, sizeof(CarRecord), reader->capacity, reader->file) : 0;
+    reader->pos = 0;
+    return reader->count > 0;
+}
+
+/**
+ * Restores the min-heap property below a heap slot
+ *
+ * @param heap Run readers ordered by their current record
+ * @param size Readers in the heap
+ * @param i Slot to sift down from
+ */
+void runHeapSiftDown(RunReader **heap, int size, int i)
+{
+    for (;;)
+    {
+        int smallest = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < size && compareStatementRecords(&heap[left]->buffer[heap[left]->pos],
+                                                   &heap[smallest]->buffer[heap[smallest]->pos]) < 0)
+            smallest = left;
+        if (right < size && compareStatementRecords(&heap[right]->buffer[heap[right]->pos],
+                                                    &heap[smallest]->buffer[heap[smallest]->pos]) < 0)
+            smallest = right;
+        if (smallest == i)
+            return;
+        RunReader *swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+/**
+ * Merges sorted runs, passing every record to a sink in order
+ *
+ * @param runs Run numbers to merge
+ * @param count Number of runs
+ * @param buffer Memory for the read buffers
+ * @param capacity Records that fit in buffer
+ * @param sink Called with each record in sorted order; returns 0 to abort
+ * @param context Passed through to sink
+ * @return 1 on success, 0 on failure
+ */
+int mergeRuns(const int *runs, int count, CarRecord *buffer, size_t capacity,
+              int (*sink)(const CarRecord *, void *), void *context)
+{
+    RunReader readers[STATEMENT_MAX_FANIN];
+    RunReader *heap[STATEMENT_MAX_FANIN];
+    int size = 0, ok = 1;
+    int perRun = (int)(capacity / count);
+
+    for (int r = 0; r < count; r++)
+    {
+        char name[64];
+        statementRunName(name, sizeof(name), runs[r]);
+        readers[r].file = openDataFile(name, "rb");
+        readers[r].buffer = buffer + (size_t)r * perRun;
+        readers[r].capacity = perRun;
+        readers[r].count = readers[r].pos = 0;
+        if (readers[r].file == NULL)
+            ok = 0;
+        else if (runReaderFill(&readers[r]))
+            heap[size++] = &readers[r];
+    }
+    for (int i = size / 2 - 1; i >= 0; i--)
+        runHeapSiftDown(heap, size, i);
+
+    // Pop the smallest record, advance its run, restore the heap
+    while (ok && size > 0)
+    {
+        RunReader *top = heap[0];
+        ok = sink(&top->buffer[top->pos], context);
+        top->pos++;
+        if (!runReaderFill(top))
+            heap[0] = heap[--size];
+        runHeapSiftDown(heap, size, 0);
+    }
+
+    for (int r = 0; r < count; r++)
+    {
+        if (readers[r].file != NULL)
+            fclose(readers[r].file);
+    }
+    return ok;
+}
+
+/**
+ * Sink that appends records to a run file
+ *
+ * @param record Next record in order
+ * @param context Open run file
+ * @return 1 on success, 0 on write failure
+ */
+int writeRunRecord(const CarRecord *record, void *context)
+{
+    return fwrite(record, sizeof(CarRecord), 1, (FILE *)context) == 1;
+}
+
+/**
+ * Finishes the statement of the current owner, if any
+ *
+ * @param writer Statement writer
+ * @return 1 on success, 0 on write failure
+ */
+int endOwnerStatement(StatementWriter *writer)
+{
+    if (!writer->hasOwner)
+        return 1;
+    writer->hasOwner = 0;
+    return fprintf(writer->file, "  Sessions: %d   Total: Rs. %.2f\n\n",
+                   writer->ownerSessions, writer->ownerTotal) > 0;
+}
+
+/**
+ * Sink that streams records, sorted by owner, into statements
+ *
+ * @param record Next record in owner/plate/entry order
+ * @param context Statement writer
+ * @return 1 on success, 0 on write failure
+ */
+int writeStatementRecord(const CarRecord *record, void *context)
+{
+    StatementWriter *writer = context;
+    int ok = 1;
+
+    if (!writer->hasOwner || stricmp(writer->owner, record->name) != 0)
+    {
+        ok = endOwnerStatement(writer);
+        snprintf(writer->owner, sizeof(writer->owner), "%s", record->name);
+        writer->hasOwner = 1;
+        writer->ownerSessions = 0;
+        writer->ownerTotal = 0;
+        writer->stats->owners++;
+        ok = ok && fprintf(writer->file,
+                           "Statement: %s\n"
+                           "  %-15s %4s  %-16s  %-16s  %10s  %10s\n",
+                           record->name, "Plate", "Spot", "Entry", "Exit", "Seconds", "Fee") > 0;
+    }
+
+    char entry[20], exitText[20] = "parked";
+    time_t entryTime = record->entry_time, exitTime = record->exit_time;
+    strftime(entry, sizeof(entry), "%Y-%m-%d %H:%M", localtime(&entryTime));
+    if (exitTime != 0)
+        strftime(exitText, sizeof(exitText), "%Y-%m-%d %H:%M", localtime(&exitTime));
+
+    ok = ok && fprintf(writer->file, "  %-15s %4d  %-16s  %-16s  %10lld  %10.2f\n",
+                       record->plate, record->spot, entry, exitText,
+                       exitTime ? (long long)(exitTime - entryTime) : 0LL, record->fee) > 0;
+    writer->ownerSessions++;
+    writer->ownerTotal += record->fee;
+    writer->stats->sessions++;
+    return ok;
+}
+
+/**
+ * Writes every owner's statement to FILENAME_STATEMENTS
+ *
+ * History is sorted by owner, plate and entry time with an external
+ * merge sort: memory-sized chunks are sorted and spilled to run files,
+ * runs are merged STATEMENT_MAX_FANIN at a time, and the last merge
+ * streams straight into the statements. Memory use stays within
+ * memoryBytes however large the history is.
+ *
+ * @param memoryBytes Memory budget for records
+ * @param stats Receives owners, sessions, runs and merge passes
+ * @return 1 on success, 0 on failure
+ */
+int generateStatements(size_t memoryBytes, StatementStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    size_t capacity = memoryBytes / sizeof(CarRecord);
+    if (capacity < STATEMENT_MAX_FANIN * 16)
+        capacity = STATEMENT_MAX_FANIN * 16;  // Enough for a full-width merge
+    CarRecord *records = malloc(capacity * sizeof(CarRecord));
+    if (records == NULL)
+        return 0;
+
+    FILE *history = openDataFile(FILENAME_HISTORY, "r");
+    StatementWriter writer = {0};
+    writer.stats = stats;
+    writer.file = openDataFile(FILENAME_STATEMENTS ".tmp", "w");
+    int ok = writer.file != NULL;
+
+    // Phase 1: sorted runs; a history that fits in memory never touches disk
+    size_t filled = 0;
+    int eof = history == NULL;
+    int *runs = NULL, runCount = 0, nextRun = 0;
+    char line[256];
+    while (ok && !eof)
+    {
+        filled = 0;
+        while (filled < capacity && !(eof = fgets(line, sizeof(line), history) == NULL))
+        {
+            CarRecord *record = &records[filled];
+            METRIC_ADD(METRIC_BYTES_READ, strlen(line));
+            METRIC_ADD(METRIC_RECORDS_SCANNED, 1);
+            if (sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld,%lf",
+                       record->name, record->plate, record->phone,
+                       record->address, &record->spot, &record->entry_time,
+                       &record->exit_time, &record->fee) == 8)
+                filled++;
+        }
+        qsort(records, filled, sizeof(CarRecord), compareStatementRecords);
+
+        if (eof && runCount == 0)
+            break;  // Single chunk: stream it below
+
+        char name[64];
+        int *grown = realloc(runs, (runCount + 1) * sizeof(int));
+        ok = grown != NULL;
+        if (ok)
+        {
+            runs = grown;
+            runs[runCount++] = nextRun;
+            statementRunName(name, sizeof(name), nextRun++);
+            FILE *run = openDataFile(name, "wb");
+            ok = run != NULL && fwrite(records, sizeof(CarRecord), filled, run) == filled;
+            if (run != NULL)
+                ok = fclose(run) == 0 && ok;
+        }
+        filled = 0;
+    }
+    if (history != NULL)
+        fclose(history);
+    stats->runs = runCount;
+
+    if (ok && runCount == 0)
+    {
+        for (size_t i = 0; ok && i < filled; i++)
+            ok = writeStatementRecord(&records[i], &writer);
+    }
+    else if (ok)
+    {
+        // Phase 2: merge passes until one merge can feed the statements
+        while (ok && runCount > STATEMENT_MAX_FANIN)
+        {
+            int merged = 0;
+            for (int first = 0; ok && first < runCount; first += STATEMENT_MAX_FANIN)
+            {
+                int count = runCount - first < STATEMENT_MAX_FANIN ? runCount - first : STATEMENT_MAX_FANIN;
+                char name[64];
+                statementRunName(name, sizeof(name), nextRun);
+                FILE *out = openDataFile(name, "wb");
+                ok = out != NULL && mergeRuns(runs + first, count, records, capacity, writeRunRecord, out);
+                if (out != NULL)
+                    ok = fclose(out) == 0 && ok;
+                for (int r = first; r < first + count; r++)
+                {
+                    statementRunName(name, sizeof(name), runs[r]);
+                    removeDataFile(name);
+                }
+                runs[merged++] = nextRun++;
+            }
+            runCount = merged;
+            stats->passes++;
+        }
+        ok = ok && mergeRuns(runs, runCount, records, capacity, writeStatementRecord, &writer);
+        stats->passes++;
+    }
+
+    // Remove whatever runs are left, including after a failure
+    for (int r = 0; r < nextRun; r++)
+    {
+        char name[64];
+        statementRunName(name, sizeof(name), r);
+        removeDataFile(name);
+    }
+    free(runs);
+    free(records);
+
+    ok = ok && endOwnerStatement(&writer);
+    if (writer.file != NULL)
+        ok = fclose(writer.file) == 0 && ok;
+    ok = ok && replaceDataFile(FILENAME_STATEMENTS ".tmp", FILENAME_STATEMENTS);
+    if (!ok)
+        removeDataFile(FILENAME_STATEMENTS ".tmp");
+    return ok;
+}
+
+/**
+ * Fingerprint of a session for duplicate detection
+ *
+ * Two rows are the same session when their normalized plates and
+ * entry times match.
+ *
+ * @param plate License plate
+ * @param entryTime Entry time
+ * @return Non-zero 64-bit fingerprint
+ */
+uint64_t sessionFingerprint(const char *plate, long long entryTime)
+{
+    char key[20];
+    normalizePlate(plate, key, sizeof(key));
+
+    // FNV-1a over the plate, then the entry time
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *p = key; *p; p++)
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    for (int i = 0; i < 8; i++)
+        hash = (hash ^ ((uint64_t)entryTime >> (8 * i) & 0xFF)) * 1099511628211ULL;
+    return hash ? hash : 1;
+}
+
+/**
+ * Adds a fingerprint to a set
+ *
+ * @param set Fingerprint set
+ * @param fingerprint Non-zero fingerprint
+ * @return 1 if added, 0 if already present, -1 if out of memory
+ */
+int fingerprintSetAdd(FingerprintSet *set, uint64_t fingerprint)
+{
+    if ((set->count + 1) * 2 > set->slotCount)
+    {
+        size_t slotCount = set->slotCount ? set->slotCount * 2 : 1 << 16;
+        uint64_t *slots = calloc(slotCount, sizeof(uint64_t));
+        if (slots == NULL)
+            return -1;
+        for (size_t i = 0; i < set->slotCount; i++)
+        {
+            if (set->slots[i] == 0)
+                continue;
+            size_t slot = set->slots[i] & (slotCount - 1);
+            while (slots[slot] != 0)
+                slot = (slot + 1) & (slotCount - 1);
+            slots[slot] = set->slots[i];
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->slotCount = slotCount;
+    }
+
+    size_t slot = fingerprint & (set->slotCount - 1);
+    while (set->slots[slot] != 0)
+    {
+        if (set->slots[slot] == fingerprint)
+            return 0;
+        slot = (slot + 1) & (set->slotCount - 1);
+    }
+    set->slots[slot] = fingerprint;
+    set->count++;
+    return 1;
+}
+
+/**
+ * Records a rejected line in import counts
+ *
+ * @param stats Import counts
+ * @param line Line number
+ * @param code Error code
+ */
+void noteImportError(ImportStats *stats, long long line, const char *code)
+{
+    if (stats->errorCount < IMPORT_MAX_ERRORS)
+    {
+        stats->errors[stats->errorCount].line = line;
+        stats->errors[stats->errorCount].code = code;
+        stats->errorCount++;
+    }
+}
+
+/**
+ * Splits one CSV line into a history record
+ *
+ * @param line Line without its newline (modified in place)
+ * @param record Receives the fields
+ * @return 1 if the line has 8 well-formed fields that fit a CarRecord
+ */
+int parseImportLine(char *line, CarRecord *record)
+{
+    char *fields[8];
+    int count = 0;
+    char *p = line;
+    while (count < 8)
+    {
+        fields[count++] = p;
+        p = strchr(p, ',');
+        if (p == NULL)
+            break;
+        *p++ = '\0';
+    }
+    if (count != 8 || p != NULL)
+        return 0;
+
+    if (strlen(fields[0]) >= sizeof(record->name) || strlen(fields[1]) >= sizeof(record->plate) ||
+        strlen(fields[2]) >= sizeof(record->phone) || strlen(fields[3]) >= sizeof(record->address))
+        return 0;
+    strcpy(record->name, fields[0]);
+    strcpy(record->plate, fields[1]);
+    strcpy(record->phone, fields[2]);
+    strcpy(record->address, fields[3]);
+
+    char *end;
+    long spot = strtol(fields[4], &end, 10);
+    if (end == fields[4] || *end)
+        return 0;
+    long long entry = strtoll(fields[5], &end, 10);
+    if (end == fields[5] || *end)
+        return 0;
+    long long exitTime = strtoll(fields[6], &end, 10);
+    if (end == fields[6] || *end)
+        return 0;
+    record->fee = strtod(fields[7], &end);
+    if (end == fields[7] || (*end && *end != '\r'))
+        return 0;
+
+    record->spot = (int)spot;
+    record->entry_time = (time_t)entry;
+    record->exit_time = (time_t)exitTime;
+    return 1;
+}
+
+/**
+ * Parser thread: validates one chunk and formats its accepted rows
+ *
+ * @param param ImportChunk to work on
+ */
+THREAD_RETURN importChunkThread(void *param)
+{
+    ImportChunk *chunk = param;
+    char *line = chunk->input;
+    char *end = chunk->input + chunk->inputLen;
+    long long lineNo = chunk->firstLine;
+
+    for (; line < end; lineNo++)
+    {
+        char *newline = memchr(line, '\n', end - line);
+        char *next = newline ? newline + 1 : end;
+        if (newline)
+            *newline = '\0';
+        else
+            *end = '\0';  // Last line without a newline; the buffer has a spare byte
+
+        CarRecord record;
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\r')
+            line[--len] = '\0';
+
+        if (len == 0)
+        {
+            line = next;
+            continue;
+        }
+        if (chunk->skipHeader && lineNo == 1 && strncmp(line, "name,", 5) == 0)
+        {
+            line = next;
+            continue;
+        }
+
+        chunk->stats.rows++;
+        if (!parseImportLine(line, &record))
+        {
+            chunk->stats.malformed++;
+            noteImportError(&chunk->stats, lineNo, "malformed");
+            line = next;
+            continue;
+        }
+
+        OpStatus status = validateCarFields(&record);
+        if (status == OP_OK && (record.spot < 1 || record.spot > PARKING_SPOTS))
+            status = OP_INVALID_SPOT;
+        if (status != OP_OK)
+        {
+            chunk->stats.rejected[status]++;
+            noteImportError(&chunk->stats, lineNo, opStatusCode(status));
+            line = next;
+            continue;
+        }
+        if (record.entry_time <= 0 || record.exit_time < record.entry_time || record.fee < 0)
+        {
+            chunk->stats.invalidTime++;
+            noteImportError(&chunk->stats, lineNo, "invalid_time");
+            line = next;
+            continue;
+        }
+
+        if (chunk->rowCount == chunk->rowCapacity)
+        {
+            int capacity = chunk->rowCapacity ? chunk->rowCapacity * 2 : 65536;
+            size_t *starts = realloc(chunk->rowStart, capacity * sizeof(size_t));
+            uint64_t *prints = starts ? realloc(chunk->fingerprint, capacity * sizeof(uint64_t)) : NULL;
+            if (starts)
+                chunk->rowStart = starts;
+            if (prints == NULL)
+            {
+                chunk->failed = 1;  // Out of memory
+                break;
+            }
+            chunk->fingerprint = prints;
+            chunk->rowCapacity = capacity;
+        }
+
+        char row[256];
+        int rowLen = snprintf(row, sizeof(row), "%s,%s,%s,%s,%d,%lld,%lld,%.2f\n",
+                              record.name, record.plate, record.phone, record.address, record.spot,
+                              (long long)record.entry_time, (long long)record.exit_time, record.fee);
+        chunk->rowStart[chunk->rowCount] = chunk->out.len;
+        chunk->fingerprint[chunk->rowCount] = sessionFingerprint(record.plate, record.entry_time);
+        if (!bufferAppend(&chunk->out, row, rowLen))
+        {
+            chunk->failed = 1;
+            break;
+        }
+        chunk->rowCount++;
+        line = next;
+    }
+    return 0;
+}
+
+/**
+ * Adds the per-chunk counts to the import totals
+ *
+ * @param total Import totals
+ * @param chunk Counts of one chunk
+ */
+void mergeImportStats(ImportStats *total, const ImportStats *chunk)
+{
+    total->rows += chunk->rows;
+    total->malformed += chunk->malformed;
+    total->invalidTime += chunk->invalidTime;
+    for (int i = 0; i < OP_IO_ERROR; i++)
+        total->rejected[i] += chunk->rejected[i];
+    for (int i = 0; i < chunk->errorCount; i++)
+        noteImportError(total, chunk->errors[i].line, chunk->errors[i].code);
+}
+
+/**
+ * Adds the sessions of history rows from an offset on to a fingerprint set
+ *
+ * A row cut by the offset was seen before and is skipped, as is a last
+ * row still missing its newline.
+ *
+ * @param seen Fingerprint set
+ * @param from File offset to start at
+ * @param scannedTo Receives the offset after the last complete row
+ * @return 1 on success, 0 if out of memory
+ */
+int addHistoryFingerprints(FingerprintSet *seen, long from, long *scannedTo)
+{
+    FILE *history = openDataFile(FILENAME_HISTORY, "r");
+    *scannedTo = 0;
+    if (history == NULL)
+        return 1;
+
+    char line[256];
+    int ok = 1;
+    if (from > 0 && fseek(history, from - 1, SEEK_SET) == 0 && fgetc(history) != '\n')
+    {
+        while (fgets(line, sizeof(line), history) && line[strlen(line) - 1] != '\n')
+            ;  // Rest of the row the offset falls into
+    }
+    else if (from > 0)
+        fseek(history, from, SEEK_SET);
+    *scannedTo = ftell(history);
+    while (ok && fgets(line, sizeof(line), history))
+    {
+        char name[50], plate[20], phone[15], address[100];
+        int spot;
+        long long entry;
+        size_t len = strlen(line);
+        if (line[len - 1] != '\n')
+            break;  // Still being written
+        METRIC_ADD(METRIC_BYTES_READ, len);
+        METRIC_ADD(METRIC_RECORDS_SCANNED, 1);
+        if (sscanf(line, "%49[^,],%19[^,],%14[^,],%99[^,],%d,%lld", name, plate, phone, address,
+                   &spot, &entry) == 6)
+            ok = fingerprintSetAdd(seen, sessionFingerprint(plate, entry)) >= 0;
+        *scannedTo = ftell(history);
+    }
+    fclose(history);
+    return ok;
+}
+
+/**
+ * Imports history rows from a CSV file in parking_history.txt format
+ *
+ * The input is read in chunks that are validated by parser threads in
+ * parallel. Accepted rows are then deduplicated (against the existing
+ * history and the rest of the input) and appended in input order. Each
+ * round of chunks is appended and synced with the history lock and the
+ * lock file held, and recorded in the history marker, so running
+ * consoles update their search cache and plate index. Rows other
+ * writers added since the history was last read are looked at first,
+ * so they count as duplicates too. The retention lock is held
+ * throughout, so no compaction swaps the file in the meantime. The
+ * column store is rebuilt if there is one.
+ *
+ * @param path Input file
+ * @param threads Parser threads
+ * @param stats Receives the row counts
+ * @return OP_OK, or OP_IO_ERROR if a file could not be read or written
+ */
+OpStatus importHistory(const char *path, int threads, ImportStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    FILE *input = fopen(path, "rb");
+    if (input == NULL)
+        return OP_IO_ERROR;
+
+    // No compaction swaps the file while rows are added
+    char ownerPath[DATA_PATH_MAX];
+    FileLock owner;
+    dataPath(ownerPath, sizeof(ownerPath), FILENAME_RETENTION_LOCK);
+    if (!acquireFileLock(ownerPath, 1, &owner))
+    {
+        fclose(input);
+        return OP_IO_ERROR;
+    }
+
+    // Sessions already in the history are duplicates too. The bulk is read
+    // without the lock; the marker tells what to read again under it.
+    FingerprintSet seen = {0};
+    long scannedTo = 0;
+    int ok = beginHistoryWrite();
+    unsigned long scannedWrites = currentFacility->marker.writes;
+    unsigned long scannedGeneration = currentFacility->marker.generation;
+    endHistoryWrite();
+    ok = ok && addHistoryFingerprints(&seen, 0, &scannedTo);
+
+    ImportChunk *chunks = calloc(threads, sizeof(ImportChunk));
+    Thread *workers = calloc(threads, sizeof(Thread));
+    char *carry = malloc(IMPORT_CHUNK_BYTES);  // Partial line left over from the last read
+    size_t carryLen = 0;
+    long long nextLine = 1;
+    int eof = 0;
+    ok = ok && chunks != NULL && workers != NULL && carry != NULL;
+    for (int t = 0; ok && t < threads; t++)
+    {
+        chunks[t].input = malloc(IMPORT_CHUNK_BYTES + 1);
+        ok = chunks[t].input != NULL;
+    }
+
+    while (ok && !eof)
+    {
+        // Read one chunk per thread, each ending on a line break
+        int filled = 0;
+        while (filled < threads && !eof)
+        {
+            ImportChunk *chunk = &chunks[filled];
+            memcpy(chunk->input, carry, carryLen);
+            size_t len = carryLen + fread(chunk->input + carryLen, 1, IMPORT_CHUNK_BYTES - carryLen, input);
+            eof = len < IMPORT_CHUNK_BYTES;
+
+            size_t cut = len;
+            if (!eof)
+            {
+                while (cut > 0 && chunk->input[cut - 1] != '\n')
+                    cut--;
+                if (cut == 0)
+                {
+                    ok = 0;  // A single line longer than a chunk
+                    break;
+                }
+            }
+            carryLen = len - cut;
+            memcpy(carry, chunk->input + cut, carryLen);
+
+            chunk->inputLen = cut;
+            chunk->firstLine = nextLine;
+            chunk->skipHeader = nextLine == 1;
+            chunk->out.len = 0;
+            chunk->rowCount = 0;
+            chunk->failed = 0;
+            memset(&chunk->stats, 0, sizeof(chunk->stats));
+            for (size_t i = 0; i < cut; i++)
+                nextLine += chunk->input[i] == '\n';
+            filled++;
+        }
+
+        // Parse in parallel; the last chunk runs on this thread
+        int started[IMPORT_MAX_THREADS] = {0};
+        for (int t = 0; t + 1 < filled; t++)
+            started[t] = threadStart(&workers[t], importChunkThread, &chunks[t]);
+        if (filled > 0)
+            importChunkThread(&chunks[filled - 1]);
+        for (int t = 0; t + 1 < filled; t++)
+        {
+            if (started[t])
+                threadJoin(workers[t]);
+            else
+                importChunkThread(&chunks[t]);
+        }
+
+        // Append accepted rows in input order, skipping duplicates. Other writers
+        // wait meanwhile, and the history marker tells readers about the new rows.
+        ok = beginHistoryWrite() && ok;
+        const HistoryMarker *marker = &currentFacility->marker;
+        long rescanFrom = scannedTo;
+        if (marker->generation != scannedGeneration || marker->writes - scannedWrites > HISTORY_MARKER_SLOTS)
+            rescanFrom = 0;
+        for (unsigned long w = scannedWrites + 1; rescanFrom > 0 && w - 1 != marker->writes; w++)
+        {
+            if (marker->changedFrom[w % HISTORY_MARKER_SLOTS] < rescanFrom)
+                rescanFrom = marker->changedFrom[w % HISTORY_MARKER_SLOTS];
+        }
+        ok = ok && addHistoryFingerprints(&seen, rescanFrom, &scannedTo);
+        FILE *out = ok ? openDataFile(FILENAME_HISTORY, "a") : NULL;
+        ok = out != NULL;
+        long before = historyFileSize();
+        for (int t = 0; ok && t < filled; t++)
+        {
+            ImportChunk *chunk = &chunks[t];
+            ok = !chunk->failed;
+            mergeImportStats(stats, &chunk->stats);
+            for (int r = 0; ok && r < chunk->rowCount; r++)
+            {
+                int added = fingerprintSetAdd(&seen, chunk->fingerprint[r]);
+                ok = added >= 0;
+                if (added == 0)
+                {
+                    stats->duplicates++;
+                    continue;
+                }
+                size_t endRow = r + 1 < chunk->rowCount ? chunk->rowStart[r + 1] : chunk->out.len;
+                size_t len = endRow - chunk->rowStart[r];
+                ok = ok && fwrite(chunk->out.data + chunk->rowStart[r], 1, len, out) == len;
+                METRIC_ADD(METRIC_BYTES_WRITTEN, len);
+                stats->imported++;
+            }
+        }
+        if (out != NULL)
+        {
+            ok = syncFile(out) && ok;
+            ok = fclose(out) == 0 && ok;
+        }
+        long after = historyFileSize();
+        if (currentFacility->writeLocked && after != before)
+        {
+            noteHistoryWrite(before > 0 ? before : 0);
+            clearSearchCache(after);
+        }
+        scannedTo = after > 0 ? after : 0;  // This round's rows are in the set already
+        scannedWrites = marker->writes;
+        scannedGeneration = marker->generation;
+        endHistoryWrite();
+    }
+
+    releaseFileLock(owner);
+    fclose(input);
+    for (int t = 0; chunks != NULL && t < threads; t++)
+    {
+        free(chunks[t].input);
+        free(chunks[t].out.data);
+        free(chunks[t].rowStart);
+        free(chunks[t].fingerprint);
+    }
+    free(chunks);
+    free(workers);
+    free(carry);
+    free(seen.slots);
+
+    // Keep the report store in step with the history
+    FILE *columns = ok && stats->imported > 0 ? openDataFile(FILENAME_COLUMNS, "rb") : NULL;
+    if (columns != NULL)
+    {
+        fclose(columns);
+        ok = exportHistoryColumns(NULL);
+    }
+    return ok ? OP_OK : OP_IO_ERROR;
+}
+
+/**
+ * Applies the retention policy to one history row
+ *
+ * Closed rows that left before the cutoff are dropped or have their
+ * personal fields (name, phone, address) replaced. Replacements are
+ * never longer than the original, so a compacted file never grows.
+ *
+ * @param line History row including its newline
+ * @param cutoff Rows that exited before this time have expired
+ * @param deleteRows 1 = drop expired rows, 0 = anonymize them
+ * @param out Receives the row to keep
+ * @param stats Counts rows scanned, anonymized and deleted
+ * @return Length of the row written to out, 0 if the row is dropped
+ */
+size_t retainHistoryRow(const char *line, time_t cutoff, int deleteRows, char *out, RetentionStats *stats)
+{
+    CarRecord record;
+    stats->scanned++;
+    if (sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld,%lf",
+               record.name, record.plate, record.phone,
+               record.address, &record.spot, &record.entry_time,
+               &record.exit_time, &record.fee) != 8 ||
+        record.exit_time == 0 || record.exit_time >= cutoff)
+    {
+        strcpy(out, line);  // Unparsable, open or still within retention: keep as is
+        return strlen(out);
+    }
+
+    if (deleteRows)
+    {
+        stats->deleted++;
+        return 0;
+    }
+    if (strcmp(record.name, RETENTION_ANONYMOUS_NAME) == 0)
+    {
+        strcpy(out, line);  // Anonymized by an earlier run
+        return strlen(out);
+    }
+
+    stats->anonymized++;
+    return (size_t)sprintf(out, "%s,%s,%s,%s,%d,%lld,%lld,%.2f\n",
+                           RETENTION_ANONYMOUS_NAME, record.plate, RETENTION_ANONYMOUS_PHONE,
+                           RETENTION_ANONYMOUS_ADDRESS, record.spot, (long long)record.entry_time,
+                           (long long)record.exit_time, record.fee);
+}
+
+/**
+ * Copies history rows from an offset through the retention policy,
+ * throttled, leaving a checkpoint at the start and then every
+ * RETENTION_THROTTLE_STEP bytes so a partly stale copy can be redone
+ * from its last exact checkpoint
+ *
+ * @param out Compacted file, positioned where the row at from goes
+ * @param from File offset of the first row to copy
+ * @param stopAtOpen 1 = stop before the first open session, 0 = copy to the end of file
+ * @param cutoff Rows that exited before this time have expired
+ * @param deleteRows 1 = drop expired rows, 0 = anonymize them
+ * @param maxBytesPerSecond Read throttle, 0 = unthrottled
+ * @param marks Checkpoints, grown as needed
+ * @param markCount Checkpoints in the table
+ * @param markCapacity Allocated checkpoints
+ * @param end Receives the offset after the last row copied
+ * @param stats Row counts (updated)
+ * @return 1 on success, 0 on failure
+ */
+int copyHistoryRows(FILE *out, long from, int stopAtOpen, time_t cutoff, int deleteRows,
+                    long maxBytesPerSecond, CopyMark **marks, int *markCount, int *markCapacity,
+                    long *end, RetentionStats *stats)
+{
+    FILE *in = openDataFile(FILENAME_HISTORY, "r");
+    if (in == NULL || fseek(in, from, SEEK_SET) != 0)
+    {
+        if (in != NULL)
+            fclose(in);
+        return 0;
+    }
+
+    char line[256], row[256];
+    long offset = from, sinceMark = RETENTION_THROTTLE_STEP, sinceCheck = 0;
+    long long bytesRead = 0;
+    unsigned long long started = tickCountMs();
+    int ok = 1;
+    while (ok)
+    {
+        if (sinceMark >= RETENTION_THROTTLE_STEP)
+        {
+            if (*markCount == *markCapacity)
+            {
+                int capacity = *markCapacity ? *markCapacity * 2 : 256;
+                CopyMark *grown = realloc(*marks, capacity * sizeof(CopyMark));
+                if (grown == NULL)
+                {
+                    ok = 0;
+                    break;
+                }
+                *marks = grown;
+                *markCapacity = capacity;
+            }
+            CopyMark *mark = &(*marks)[(*markCount)++];
+            mark->fileOffset = offset;
+            mark->outOffset = (size_t)ftell(out);
+            mark->scanned = stats->scanned;
+            mark->anonymized = stats->anonymized;
+            mark->deleted = stats->deleted;
+            sinceMark = 0;
+        }
+
+        CarRecord record;
+        if (!fgets(line, sizeof(line), in))
+            break;
+        if (stopAtOpen &&
+            sscanf(line, "%[^,],%[^,],%[^,],%[^,],%d,%ld,%ld",
+                   record.name, record.plate, record.phone, record.address,
+                   &record.spot, &record.entry_time, &record.exit_time) == 7 &&
+            record.exit_time == 0)
+            break;  // First open session: the tail starts here
+
+        size_t len = retainHistoryRow(line, cutoff, deleteRows, row, stats);
+        ok = fwrite(row, 1, len, out) == len;
+        offset = ftell(in);
+
+        size_t lineLen = strlen(line);
+        METRIC_ADD(METRIC_BYTES_READ, lineLen);
+        METRIC_ADD(METRIC_RECORDS_SCANNED, 1);
+        bytesRead += lineLen;
+        sinceMark += (long)lineLen;
+        sinceCheck += (long)lineLen;
+        if (maxBytesPerSecond > 0 && sinceCheck >= RETENTION_THROTTLE_STEP)
+        {
+            unsigned long long due = started + (unsigned long long)(bytesRead * 1000 / maxBytesPerSecond);
+            unsigned long long now = tickCountMs();
+            if (due > now)
+                sleepMs((unsigned)(due - now));
+            sinceCheck = 0;
+        }
+    }
+    *end = offset;
+    fclose(in);
+    return ok;
+}
+
+/**
+ * Rewrites the history with expired personal data removed
+ *
+ * Runs alongside the gates without holding them up:
+ * 1. Rows before the first open session do not change in normal
+ *    operation, so that prefix is rewritten into a temporary file with
+ *    no lock held, throttled to maxBytesPerSecond.
+ * 2. The remaining tail is streamed after it the same way, throttled
+ *    too; only checkpoints are kept, not the rows.
+ * 3. With the lock file held (every process takes it to write the
+ *    history), the marker in it tells the lowest offset written
+ *    meanwhile. A change inside the prefix (a failed batch, a repair)
+ *    means copying again from the checkpoint before it, with the lock
+ *    released. Otherwise the tail is copied again from the checkpoint
+ *    before the change, reading the file under the lock; then the
+ *    file is swapped in atomically.
+ * Only one process compacts a facility at a time, so none resets the
+ * marker under another.
+ *
+ * @param cutoff Rows that exited before this time have expired
+ * @param deleteRows 1 = drop expired rows, 0 = anonymize them
+ * @param maxBytesPerSecond Read throttle for steps 1 and 2, 0 = unthrottled
+ * @param wait 1 = wait for a compaction in another process, 0 = skip this one then
+ * @param stats Receives the row counts and file sizes
+ * @return 1 on success (including nothing to do), 0 on failure
+ */
+int compactHistory(time_t cutoff, int deleteRows, long maxBytesPerSecond, int wait, RetentionStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (historyFileSize() < 0)
+        return 1;
+    char ownerPath[DATA_PATH_MAX];
+    FileLock owner;
+    dataPath(ownerPath, sizeof(ownerPath), FILENAME_RETENTION_LOCK);
+    if (!acquireFileLock(ownerPath, wait, &owner))
+        return !wait;  // Another process is compacting right now
+    FILE *out = openDataFile(FILENAME_HISTORY ".compact.tmp", "w");
+    if (out == NULL)
+    {
+        releaseFileLock(owner);
+        return 0;
+    }
+    removeDataFile(FILENAME_HISTORY ".compact.old");
+
+    // Writes from here on, by any process, move the marker
+    int ok = beginHistoryWrite();
+    currentFacility->marker.compactFrom = LONG_MAX;
+    saveHistoryMarker();
+    endHistoryWrite();
+
+    CopyMark *marks = NULL;
+    int markCount = 0, markCapacity = 0, tailMark = 0;
+    long from = 0, stableEnd = 0;
+    for (int attempt = 1;; attempt++)
+    {
+        // Step 1: the stable prefix, throttled
+        ok = ok && copyHistoryRows(out, from, 1, cutoff, deleteRows, maxBytesPerSecond,
+                                   &marks, &markCount, &markCapacity, &stableEnd, stats);
+
+        // Step 2: the tail, streamed the same way; its first checkpoint is at stableEnd
+        tailMark = markCount;
+        ok = ok && copyHistoryRows(out, stableEnd, 0, cutoff, deleteRows, maxBytesPerSecond,
+                                   &marks, &markCount, &markCapacity, &stats->bytesBefore, stats) &&
+             syncFile(out);  // So the sync under the lock only covers the redone rows
+
+        // Step 3 starts here, with the lock file held from now on
+        ok = beginHistoryWrite() && ok;
+        long changedFrom = currentFacility->marker.compactFrom;
+        if (!ok || changedFrom >= stableEnd)
+            break;
+        if (attempt == RETENTION_MAX_ATTEMPTS)
+        {
+            ok = 0;  // The prefix keeps changing; try again next time
+            break;
+        }
+
+        // The prefix changed: go back to the last checkpoint before the change
+        int mark = tailMark - 1;
+        while (mark > 0 && marks[mark].fileOffset > changedFrom)
+            mark--;
+        from = marks[mark].fileOffset;
+        stats->scanned = marks[mark].scanned;
+        stats->anonymized = marks[mark].anonymized;
+        stats->deleted = marks[mark].deleted;
+        ok = truncateFile(out, (long)marks[mark].outOffset) &&
+             fseek(out, (long)marks[mark].outOffset, SEEK_SET) == 0;
+        markCount = mark;  // The copy records it again
+        currentFacility->marker.compactFrom = LONG_MAX;
+        saveHistoryMarker();
+        endHistoryWrite();
+    }
+
+    // Redo tail rows written meanwhile and swap. The old file keeps a second
+    // name until the lock is released, so the swap does not have to free its blocks.
+    METRIC_START(lockStart);
+    long changedFrom = currentFacility->marker.compactFrom;
+    if (ok && changedFrom != LONG_MAX)
+    {
+        // Rows before the last checkpoint ahead of the change are still exact
+        long written = ftell(out);
+        int mark = markCount - 1;
+        while (mark > tailMark && marks[mark].fileOffset > changedFrom)
+            mark--;
+        long redoStart = marks[mark].fileOffset;
+        stats->scanned = marks[mark].scanned;
+        stats->anonymized = marks[mark].anonymized;
+        stats->deleted = marks[mark].deleted;
+        ok = fseek(out, (long)marks[mark].outOffset, SEEK_SET) == 0;
+        markCount = mark;
+
+        // Rows only grow when closed, so the rewrite covers everything written before;
+        // if it ever does not, leave the file alone rather than truncate
+        ok = ok && copyHistoryRows(out, redoStart, 0, cutoff, deleteRows, 0, &marks, &markCount,
+                                   &markCapacity, &stats->bytesBefore, stats) &&
+             ftell(out) >= written && syncFile(out);
+    }
+
+    if (ok && stats->anonymized + stats->deleted > 0)
+    {
+        stats->bytesAfter = ftell(out);
+        ok = fclose(out) == 0 && ok;
+        out = NULL;
+        char historyPath[DATA_PATH_MAX], oldPath[DATA_PATH_MAX];
+        dataPath(historyPath, sizeof(historyPath), FILENAME_HISTORY);
+        dataPath(oldPath, sizeof(oldPath), FILENAME_HISTORY ".compact.old");
+        linkFile(historyPath, oldPath);
+        ok = ok && replaceDataFile(FILENAME_HISTORY ".compact.tmp", FILENAME_HISTORY);
+        if (ok)
+        {
+            noteHistoryReplaced();
+            clearSearchCache(stats->bytesAfter);
+        }
+    }
+    else
+        stats->bytesAfter = stats->bytesBefore;
+    METRIC_OBSERVE(METRIC_COMPACTION_LOCK, lockStart);
+    endHistoryWrite();
+    free(marks);
+
+    if (out != NULL)
+        fclose(out);
+    removeDataFile(FILENAME_HISTORY ".compact.tmp");
+    removeDataFile(FILENAME_HISTORY ".compact.old");
+    releaseFileLock(owner);
+    METRIC_ADD(METRIC_ROWS_EXPIRED, stats->anonymized + stats->deleted);
+    return ok;
+}
+
+/**
+ * Background retention task: compacts the history now and then every
+ * RETENTION_INTERVAL_MS, throttled so gates and searches are not slowed
+ *
+ * @param param Unused
+ */
+THREAD_RETURN retentionThread(void *param)
+{
+    currentFacility = param;
+    for (;;)
+    {
+        RetentionStats stats;
+        time_t cutoff = time(NULL) - (time_t)RETENTION_DAYS * 86400;
+        if (compactHistory(cutoff, RETENTION_DELETE, RETENTION_MAX_BYTES_PER_SEC, 0, &stats) &&
+            stats.anonymized + stats.deleted > 0)
+        {
+            // The report store holds owner names too
+            FILE *columns = openDataFile(FILENAME_COLUMNS, "rb");
+            if (columns != NULL)
+            {
+                fclose(columns);
+                exportHistoryColumns(NULL);
+            }
+        }
+        sleepMs(RETENTION_INTERVAL_MS);
+    }
+    return 0;
+}
+
+/**
+ * Starts the background retention task of the current facility
+ */
+void startRetentionTask()
+{
+    Thread thread;
+    if (threadStart(&thread, retentionThread, currentFacility))
+        threadDetach(thread);
+}
+
+/**
+ * Scan thread: collects the open rows of one slice of the history
+ *
+ * Only the exit time field is looked at for closed rows; open rows are
+ * parsed for plate, spot and entry time.
+ *
+ * @param param VerifyChunk to work on
+ */
+THREAD_RETURN verifyChunkThread(void *param)
+{
+    VerifyChunk *chunk = param;
+    FILE *file = openDataFile(FILENAME_HISTORY, "rb");
+    if (file == NULL)
+    {
+        chunk->failed = 1;
+        return 0;
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+    // A row belongs to the slice it starts in: skip the end of the previous one
+    long pos = chunk->start > 0 ? chunk->start - 1 : 0;
+    fseek(file, pos, SEEK_SET);
+    if (chunk->start > 0)
+    {
+        int c;
+        do
+        {
+            c = fgetc(file);
+            pos++;
+        } while (c != EOF && c != '\n');
+    }
+
+    char line[256];
+#if METRICS_ENABLED
+    long firstPos = pos;
+#endif
+    while (pos < chunk->end && fgets(line, sizeof(line), file))
+    {
+        size_t len = strlen(line);
+        long rowStart = pos;
+        pos += (long)len;
+        chunk->scanned++;
+
+        int lineEnd = 0;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        {
+            line[--len] = '\0';
+            lineEnd++;
+        }
+        char *fee = strrchr(line, ',');
+        if (fee == NULL)
+            continue;
+        *fee = '\0';
+        char *exitTime = strrchr(line, ',');
+        if (exitTime == NULL || strcmp(exitTime + 1, "0") != 0)
+            continue;  // Closed row (or not a row at all)
+
+        OpenSession session;
+        long long entryTime;
+        if (sscanf(line, "%*[^,],%19[^,],%*[^,],%*[^,],%d,%lld", session.plate,
+                   &session.spot, &entryTime) != 3)
+            continue;
+        session.entryTime = entryTime;
+        session.offset = rowStart;
+        session.lineEnd = lineEnd;
+        if (chunk->count == chunk->capacity)
+        {
+            int capacity = chunk->capacity ? chunk->capacity * 2 : 256;
+            OpenSession *grown = realloc(chunk->rows, capacity * sizeof(OpenSession));
+            if (grown == NULL)
+            {
+                chunk->failed = 1;
+                break;
+            }
+            chunk->rows = grown;
+            chunk->capacity = capacity;
+        }
+        chunk->rows[chunk->count++] = session;
+    }
+    METRIC_ADD(METRIC_BYTES_READ, pos - firstPos);
+    METRIC_ADD(METRIC_RECORDS_SCANNED, chunk->scanned);
+    if (ferror(file))
+        chunk->failed = 1;
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Collects the open rows of the whole history, one slice per thread
+ *
+ * @param size History size in bytes
+ * @param rows Receives the open rows in file order (free() them)
+ * @param stats Receives the rows scanned and threads used
+ * @return Number of open rows, -1 if the history could not be read
+ */
+int scanOpenSessions(long size, OpenSession **rows, VerifyStats *stats)
+{
+    int threads = (int)(size / VERIFY_MIN_CHUNK_BYTES) + 1;
+    if (threads > cpuCount())
+        threads = cpuCount();
+    if (threads > VERIFY_MAX_THREADS)
+        threads = VERIFY_MAX_THREADS;
+    stats->threads = threads;
+    *rows = NULL;
+
+    VerifyChunk chunks[VERIFY_MAX_THREADS];
+    Thread workers[VERIFY_MAX_THREADS];
+    int started[VERIFY_MAX_THREADS] = {0};
+    memset(chunks, 0, sizeof(chunks));
+    for (int t = 0; t < threads; t++)
+    {
+        chunks[t].start = (long)((long long)size * t / threads);
+        chunks[t].end = (long)((long long)size * (t + 1) / threads);
+    }
+
+    // The first slice runs on this thread
+    for (int t = 1; t < threads; t++)
+        started[t] = threadStart(&workers[t], verifyChunkThread, &chunks[t]);
+    verifyChunkThread(&chunks[0]);
+    for (int t = 1; t < threads; t++)
+    {
+        if (started[t])
+            threadJoin(workers[t]);
+        else
+            verifyChunkThread(&chunks[t]);
+    }
+
+    int total = 0, failed = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        total += chunks[t].count;
+        failed |= chunks[t].failed;
+        stats->scanned += chunks[t].scanned;
+    }
+    *rows = failed ? NULL : malloc((total ? total : 1) * sizeof(OpenSession));
+    for (int t = 0, at = 0; t < threads; t++)
+    {
+        if (*rows != NULL)
+            memcpy(*rows + at, chunks[t].rows, chunks[t].count * sizeof(OpenSession));
+        at += chunks[t].count;
+        free(chunks[t].rows);
+    }
+    return *rows != NULL ? total : -1;
+}
+
+/**
+ * Records a discrepancy in the check result
+ *
+ * @param stats Check result
+ * @param code Kind of discrepancy
+ * @param spot Bay
+ * @param plate Plate of the row or the parked car
+ * @param entryTime Entry time of the row or the parked car
+ */
+void noteDiscrepancy(VerifyStats *stats, const char *code, int spot, const char *plate, int64_t entryTime)
+{
+    if (strcmp(code, "no_open_row") == 0)
+        stats->missingRows++;
+    else
+        stats->staleRows++;
+    if (stats->listed == VERIFY_MAX_LISTED)
+        return;
+    Discrepancy *entry = &stats->list[stats->listed++];
+    entry->code = code;
+    entry->spot = spot;
+    snprintf(entry->plate, sizeof(entry->plate), "%s", plate);
+    entry->entryTime = entryTime;
+}
+
+/**
+ * Closes stale open rows at their recorded offsets
+ *
+ * A stale row gets its entry time as exit time and keeps its zero fee:
+ * the real exit time was lost. Everything from the first stale row to
+ * the end of file is rebuilt in memory and written back in one go.
+ *
+ * @param rows Open rows in file order
+ * @param codes Discrepancy code of each row, NULL for rows left open
+ * @param count Number of rows
+ * @param changedFrom Receives the offset of the first rewritten byte
+ * @return 1 on success, 0 if the history file could not be written
+ */
+int closeStaleSessions(const OpenSession *rows, const char **codes, int count, long *changedFrom)
+{
+    int first = 0;
+    while (first < count && codes[first] == NULL)
+        first++;
+    if (first == count)
+        return 1;
+
+    FILE *file = openDataFile(FILENAME_HISTORY, "r+b");
+    if (file == NULL)
+        return 0;
+    long start = rows[first].offset;
+    fseek(file, 0, SEEK_END);
+    size_t len = (size_t)(ftell(file) - start);
+    char *old = malloc(len + 1);
+    ByteBuffer tail = {0};
+    fseek(file, start, SEEK_SET);
+    int ok = old != NULL && fread(old, 1, len, file) == len;
+    METRIC_ADD(METRIC_BYTES_READ, len);
+
+    size_t cursor = 0;
+    for (int i = first; ok && i < count; i++)
+    {
+        if (codes[i] == NULL)
+            continue;
+        size_t row = (size_t)(rows[i].offset - start);
+        char *newline = memchr(old + row, '\n', len - row);
+        size_t rowEnd = newline ? (size_t)(newline - old) + 1 : len;
+        size_t textEnd = rowEnd - rows[i].lineEnd;
+
+        // "...,entry,0,fee" becomes "...,entry,entry,fee"
+        char *feeComma = old + textEnd;
+        while (*--feeComma != ',')
+            ;
+        char *exitComma = feeComma;
+        while (*--exitComma != ',')
+            ;
+        char exitTime[24];
+        int exitLen = snprintf(exitTime, sizeof(exitTime), "%lld", (long long)rows[i].entryTime);
+        ok = bufferAppend(&tail, old + cursor, (size_t)(exitComma + 1 - old) - cursor) &&
+             bufferAppend(&tail, exitTime, exitLen);
+        cursor = (size_t)(feeComma - old);
+    }
+    ok = ok && bufferAppend(&tail, old + cursor, len - cursor);
+
+    // Closed rows are never shorter than open ones, so no truncation is needed
+    if (ok)
+    {
+        fseek(file, start, SEEK_SET);
+        ok = fwrite(tail.data, 1, tail.len, file) == tail.len && syncFile(file);
+        METRIC_ADD(METRIC_BYTES_WRITTEN, tail.len);
+        *changedFrom = start;
+    }
+    free(old);
+    free(tail.data);
+    return fclose(file) == 0 && ok;
+}
+
+/**
+ * Appends open rows for occupied bays that have none
+ *
+ * The owner details were never written, so the row carries the
+ * retention placeholders; plate, spot and entry time come from the bay.
+ *
+ * @param spots Spot state
+ * @param matched Open row matched to each bay, -1 for none
+ * @return Rows appended, -1 if the history file could not be written
+ */
+int appendMissingSessions(const SpotTable *spots, const int *matched)
+{
+    FILE *file = NULL;
+    int appended = 0;
+    long written = 0;
+    for (int spot = nextOccupiedSpot(spots, 0); spot != 0; spot = nextOccupiedSpot(spots, spot))
+    {
+        if (matched[spot - 1] >= 0)
+            continue;
+        if (file == NULL && (file = openDataFile(FILENAME_HISTORY, "a")) == NULL)
+            return -1;
+        written += fprintf(file, "%s,%s,%s,%s,%d,%lld,0,0.00\n", RETENTION_ANONYMOUS_NAME,
+                           spots->plates[spot - 1], RETENTION_ANONYMOUS_PHONE,
+                           RETENTION_ANONYMOUS_ADDRESS, spot, (long long)spots->entryTimes[spot - 1]);
+        appended++;
+    }
+    if (file == NULL)
+        return 0;
+    METRIC_ADD(METRIC_BYTES_WRITTEN, written);
+    int ok = syncFile(file);
+    return fclose(file) == 0 && ok ? appended : -1;
+}
+
+/**
+ * Cross-checks spot state against the open history rows
+ *
+ * Each occupied bay should have exactly one open row (exit_time == 0)
+ * with its spot and plate, and every open row should belong to an
+ * occupied bay. A crash between the spots and history writes of a
+ * batch breaks this: an entry leaves an occupied bay without a row, an
+ * exit an open row for an empty bay. The history is scanned in slices
+ * by parallel threads. A repair holds the history lock and the
+ * facility's lock file throughout, so neither this process nor another
+ * gate writes meanwhile. A report takes no lock: a car that parks or
+ * leaves during the scan may show up as a discrepancy, which a repair
+ * (checking again under the lock) then finds gone.
+ *
+ * Repair appends a placeholder open row for each bay without one and
+ * closes the other open rows; when one car has several, the row whose
+ * entry time matches the bay (else the latest) is kept.
+ *
+ * @param repair 1 to repair, 0 to only report
+ * @param stats Receives the counts and the first discrepancies
+ * @return OP_OK, or OP_IO_ERROR if a file could not be read or written
+ *         (or, when repairing, the lock file could not be locked)
+ */
+OpStatus verifySpotState(int repair, VerifyStats *stats)
+{
+    unsigned long long started = tickCountUs();
+    memset(stats, 0, sizeof(*stats));
+
+    // A repair must not race another process between its spots and history
+    // writes. A report only reads, so it leaves the gates running meanwhile.
+    int locked = repair ? beginHistoryWrite() : 0;
+    SpotTable spots = {0};
+    OpenSession *rows = NULL;
+    long size = historyFileSize();
+    int ok = (locked || !repair) && loadSpotTable(&spots);
+    int count = ok && size > 0 ? scanOpenSessions(size, &rows, stats) : 0;
+    const char **codes = count > 0 ? calloc(count, sizeof(const char *)) : NULL;
+    int *matched = ok ? malloc(spots.count * sizeof(int)) : NULL;
+    ok = ok && count >= 0 && (count == 0 || codes != NULL) && matched != NULL;
+
+    if (ok)
+    {
+        stats->openRows = count;
+        stats->occupied = countOccupiedSpots(&spots);
+        for (int spot = 1; spot <= spots.count; spot++)
+            matched[spot - 1] = -1;
+        for (int i = 0; i < count; i++)
+        {
+            int spot = rows[i].spot;
+            if (spot < 1 || spot > spots.count || !spotOccupied(&spots, spot))
+                codes[i] = "bay_empty";
+            else if (strcmp(rows[i].plate, spots.plates[spot - 1]) != 0)
+                codes[i] = "bay_taken";
+            else if (matched[spot - 1] < 0)
+                matched[spot - 1] = i;
+            else
+            {
+                // Several open rows for the parked car: keep the best one
+                int kept = matched[spot - 1];
+                int64_t bayEntry = spots.entryTimes[spot - 1];
+                if (rows[i].entryTime == bayEntry || rows[kept].entryTime != bayEntry)
+                {
+                    codes[kept] = "duplicate";
+                    matched[spot - 1] = i;
+                }
+                else
+                    codes[i] = "duplicate";
+            }
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            if (codes[i] != NULL)
+                noteDiscrepancy(stats, codes[i], rows[i].spot, rows[i].plate, rows[i].entryTime);
+        }
+        for (int spot = nextOccupiedSpot(&spots, 0); spot != 0; spot = nextOccupiedSpot(&spots, spot))
+        {
+            if (matched[spot - 1] < 0)
+                noteDiscrepancy(stats, "no_open_row", spot, spots.plates[spot - 1],
+                                spots.entryTimes[spot - 1]);
+        }
+    }
+
+    int repaired = 0;
+    if (ok && repair && stats->missingRows + stats->staleRows > 0)
+    {
+        long changedFrom = size > 0 ? size : 0;
+        ok = closeStaleSessions(rows, codes, count, &changedFrom);
+        int appended = ok ? appendMissingSessions(&spots, matched) : -1;
+        ok = appended >= 0;
+        if (ok)
+            stats->repaired = stats->staleRows + appended;
+        repaired = 1;
+
+        // Cached searches and a running compaction must not trust the old file
+        noteHistoryWrite(ok ? changedFrom : 0);
+        clearSearchCache(historyFileSize());
+    }
+    if (repair)
+        endHistoryWrite();
+
+    free(rows);
+    free(codes);
+    free(matched);
+    freeSpotTable(&spots);
+
+    // Closed sessions changed, so the report store is out of date
+    FILE *columns = ok && repaired && stats->staleRows > 0 ? openDataFile(FILENAME_COLUMNS, "rb") : NULL;
+    if (columns != NULL)
+    {
+        fclose(columns);
+        ok = exportHistoryColumns(NULL);
+    }
+    stats->wallUs = tickCountUs() - started;
+    return ok ? OP_OK : OP_IO_ERROR;
+}
+
+/**
+ * Prepares a facility
+ *
+ * @param facility Facility to set up
+ * @param id Name used on the command line
+ * @param directory Data directory ("" = working directory)
+ */
+void initFacility(Facility *facility, const char *id, const char *directory)
+{
+    memset(facility, 0, sizeof(*facility));
+    snprintf(facility->id, sizeof(facility->id), "%s", id);
+    snprintf(facility->directory, sizeof(facility->directory), "%s", directory);
+    initSearchCache(&facility->searchCache);
+    initReservations(&facility->reservations);
+    facility->marker.compactFrom = LONG_MAX;
+    mutexInit(&facility->taskLock);
+    condInit(&facility->taskPending);
+    condInit(&facility->taskDone);
+}
+
+/**
+ * Reads the facilities file and sets up every facility listed
+ *
+ * Each line is "id,directory"; missing directories are created.
+ *
+ * @return Number of facilities, 0 if there is no facilities file
+ */
+int loadFacilities()
+{
+    FILE *file = fopen(FILENAME_FACILITIES, "r");
+    if (file == NULL)
+        return 0;
+
+    char line[256], id[32], directory[200];
+    while (facilityCount < MAX_FACILITIES && fgets(line, sizeof(line), file))
+    {
+        if (line[0] == '#' || sscanf(line, "%31[^,],%199[^\r\n]", id, directory) != 2)
+            continue;
+        Facility *facility = malloc(sizeof(Facility));
+        if (facility == NULL)
+            break;
+        if (!makeDirectory(directory))
+        {
+            free(facility);
+            continue;
+        }
+        initFacility(facility, id, directory);
+        facilities[facilityCount++] = facility;
+    }
+    fclose(file);
+    return facilityCount;
+}
+
+/**
+ * Looks up a facility by id
+ *
+ * @param id Facility id (case-insensitive)
+ * @return Facility, NULL if none has that id
+ */
+Facility *findFacility(const char *id)
+{
+    for (int i = 0; i < facilityCount; i++)
+    {
+        if (stricmp(facilities[i]->id, id) == 0)
+            return facilities[i];
+    }
+    return NULL;
+}
+
+/**
+ * Worker thread of one facility: owns its state and runs its tasks in order
+ *
+ * @param param Facility
+ */
+THREAD_RETURN facilityWorkerThread(void *param)
+{
+    currentFacility = param;
+    initializeParkingSpots();  // Create or verify this site's spots file
+    startGroupCommitWriter();
+
+    Facility *facility = currentFacility;
+    mutexLock(&facility->taskLock);
+    for (;;)
+    {
+        while (facility->taskHead == NULL)
+            condWait(&facility->taskPending, &facility->taskLock, WAIT_FOREVER);
+        FacilityTask *task = facility->taskHead;
+        facility->taskHead = task->next;
+        if (facility->taskHead == NULL)
+            facility->taskTail = NULL;
+
+        mutexUnlock(&facility->taskLock);
+        task->run(task->context);
+        mutexLock(&facility->taskLock);
+
+        task->done = 1;
+        condBroadcast(&facility->taskDone);
+    }
+    return 0;
+}
+
+/**
+ * Queues a task on a facility's worker thread, starting the worker on first use
+ *
+ * If no thread can be started the task runs at once on the caller,
+ * switched to the facility for the duration.
+ *
+ * @param facility Facility
+ * @param task Task (must stay valid until waitFacilityTask() returns)
+ */
+void postFacilityTask(Facility *facility, FacilityTask *task)
+{
+    task->done = 0;
+    task->next = NULL;
+
+    mutexLock(&facility->taskLock);
+    if (!facility->workerStarted)
+    {
+        Thread thread;
+        facility->workerStarted = threadStart(&thread, facilityWorkerThread, facility);
+        if (facility->workerStarted)
+            threadDetach(thread);
+    }
+    if (!facility->workerStarted)
+    {
+        mutexUnlock(&facility->taskLock);
+        Facility *previous = currentFacility;
+        currentFacility = facility;
+        initializeParkingSpots();
+        task->run(task->context);
+        currentFacility = previous;
+        task->done = 1;
+        return;
+    }
+
+    if (facility->taskTail != NULL)
+        facility->taskTail->next = task;
+    else
+        facility->taskHead = task;
+    facility->taskTail = task;
+    condSignal(&facility->taskPending);
+    mutexUnlock(&facility->taskLock);
+}
+
+/**
+ * Waits until a posted task has run
+ *
+ * @param facility Facility the task was posted to
+ * @param task Task
+ */
+void waitFacilityTask(Facility *facility, FacilityTask *task)
+{
+    mutexLock(&facility->taskLock);
+    while (!task->done)
+        condWait(&facility->taskDone, &facility->taskLock, WAIT_FOREVER);
+    mutexUnlock(&facility->taskLock);
+}
+
+/**
+ * Runs one task per facility, all facilities in parallel
+ *
+ * @param run Called on each facility's worker with that facility's context
+ * @param contexts First context
+ * @param contextSize Size of one context
+ */
+void fanOut(void (*run)(void *context), void *contexts, size_t contextSize)
+{
+    FacilityTask tasks[MAX_FACILITIES];
+    for (int i = 0; i < facilityCount; i++)
+    {
+        tasks[i].run = run;
+        tasks[i].context = (char *)contexts + i * contextSize;
+        postFacilityTask(facilities[i], &tasks[i]);
+    }
+    for (int i = 0; i < facilityCount; i++)
+        waitFacilityTask(facilities[i], &tasks[i]);
+}
+
+/**
+ * Fan-out task: finds a plate among the cars parked at the current facility
+ *
+ * @param context PlateWhereabouts
+ */
+void locatePlate(void *context)
+{
+    PlateWhereabouts *where = context;
+    SpotTable spots;
+    where->similar.count = 0;
+    where->ok = loadSpotTable(&spots);
+    where->spot = where->ok ? findParkedSpot(&spots, where->plate) : 0;
+    if (where->spot != 0)
+    {
+        strcpy(where->parkedPlate, spots.plates[where->spot - 1]);
+        where->entryTime = spots.entryTimes[where->spot - 1];
+    }
+    freeSpotTable(&spots);
+    if (where->spot != 0)
+        return;
+
+    // Not parked here under that plate: suggest misreads
+    refreshPlateIndex(&currentFacility->plateIndex);
+    lookupPlates(&currentFacility->plateIndex, where->plate, 1, &where->similar);
+}
+
+/**
+ * Fan-out task: counts parked cars and held bays at the current facility
+ *
+ * @param context FacilityOccupancy
+ */
+void measureOccupancy(void *context)
+{
+    FacilityOccupancy *occupancy = context;
+    SpotTable spots;
+    ReservationBook *book = &currentFacility->reservations;
+    time_t now = time(NULL);
+    occupancy->occupied = occupancy->held = 0;
+    occupancy->ok = loadSpotTable(&spots);
+    if (occupancy->ok)
+    {
+        occupancy->occupied = countOccupiedSpots(&spots);
+        mutexLock(&book->lock);
+        refreshReservations(book);
+        for (int spot = nextFreeSpot(&spots, 0); spot != 0; spot = nextFreeSpot(&spots, spot))
+            occupancy->held += spotHeld(book, spot, NULL, now);
+        mutexUnlock(&book->lock);
+    }
+    freeSpotTable(&spots);
+}
+
+/**
+ * Next number from the simulator's random generator (splitmix64)
+ *
+ * @param state Generator state, advanced
+ * @return 64 random bits
+ */
+unsigned long long simRandom(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Uniform random number in (0, 1]
+ *
+ * @param state Generator state, advanced
+ * @return Random number
+ */
+double simUniform(unsigned long long *state)
+{
+    return ((simRandom(state) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Relative arrival rate at a time of day
+ *
+ * The rush-hour profile is a weekday commuter pattern with morning and
+ * evening peaks; its 24 weights average 1, so the mean rate is kept.
+ *
+ * @param config Simulation parameters
+ * @param hour Hour of the day (0-23)
+ * @return Rate multiplier
+ */
+double simRateFactor(const SimConfig *config, int hour)
+{
+    static const double rush[24] = {
+        0.10, 0.05, 0.05, 0.05, 0.10, 0.30, 0.90, 2.20, 3.00, 2.20, 1.20, 1.00,
+        1.20, 1.20, 1.00, 1.00, 1.30, 2.00, 2.20, 1.20, 0.60, 0.40, 0.30, 0.25};
+    return config->rushHour ? rush[hour] : 1.0;
+}
+
+/**
+ * Draws a stay length
+ *
+ * @param config Simulation parameters
+ * @param state Generator state, advanced
+ * @return Stay in seconds (at least one)
+ */
+time_t simDwell(const SimConfig *config, unsigned long long *state)
+{
+    double mean = config->dwellMinutes * 60;
+    double seconds = mean;
+    if (config->dwell == DWELL_EXPONENTIAL)
+        seconds = -log(simUniform(state)) * mean;
+    else if (config->dwell == DWELL_LOGNORMAL)
+    {
+        // Box-Muller normal, shifted so the log-normal has the requested mean
+        double normal = sqrt(-2 * log(simUniform(state))) * cos(2 * 3.14159265358979 * simUniform(state));
+        seconds = exp(log(mean) - SIM_LOGNORMAL_SIGMA * SIM_LOGNORMAL_SIGMA / 2 + SIM_LOGNORMAL_SIGMA * normal);
+    }
+    return seconds < 1 ? 1 : (time_t)seconds;
+}
+
+/**
+ * Next arrival after a time: a Poisson process whose rate follows the
+ * profile, drawn by thinning a process at the peak rate
+ *
+ * @param config Simulation parameters
+ * @param state Generator state, advanced
+ * @param after Previous arrival (virtual time)
+ * @return Virtual time of the next arrival
+ */
+double simNextArrival(const SimConfig *config, unsigned long long *state, double after)
+{
+    double peak = 0;
+    for (int h = 0; h < 24; h++)
+    {
+        if (simRateFactor(config, h) > peak)
+            peak = simRateFactor(config, h);
+    }
+    double perSecond = config->rate * peak / 3600;
+    double time = after;
+    for (;;)
+    {
+        time += -log(simUniform(state)) / perSecond;
+        int hour = (int)((time - SIM_START_TIME) / 3600) % 24;
+        if (simUniform(state) * peak <= simRateFactor(config, hour))
+            return time;
+    }
+}
+
+/**
+ * Mixes one outcome into the run checksum (FNV-1a)
+ *
+ * @param checksum Checksum so far
+ * @param value Outcome
+ */
+void simChecksum(unsigned long long *checksum, long long value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        *checksum ^= (unsigned char)(value >> (i * 8));
+        *checksum *= 0x100000001B3ULL;
+    }
+}
+
+/**
+ * Restores the departure heap order below a position
+ *
+ * @param heap Departures, earliest first
+ * @param size Heap size
+ * @param i Position to sift down
+ */
+void simHeapSiftDown(SimDeparture *heap, int size, int i)
+{
+    for (;;)
+    {
+        int smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < size && heap[left].time < heap[smallest].time)
+            smallest = left;
+        if (right < size && heap[right].time < heap[smallest].time)
+            smallest = right;
+        if (smallest == i)
+            return;
+        SimDeparture swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+/**
+ * Compares latencies for qsort()
+ */
+int compareLatencies(const void *a, const void *b)
+{
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Runs a traffic simulation against a scratch facility
+ *
+ * Arrivals and stays are drawn from a seeded generator and played in
+ * virtual time through parkCar() and leaveCar(), as fast as the engine
+ * allows. Every outcome goes into a checksum, so two runs with the same
+ * parameters must print the same checksum. Entries and exits are
+ * committed directly rather than through a group commit writer, since
+ * one driver never has batch-mates to wait for.
+ *
+ * The scratch facility is only wiped if the simulator created it
+ * (FILENAME_SIM_MARKER is there) or it holds none of the data files.
+ *
+ * @param config Simulation parameters
+ * @param stats Receives the results; free parkUs and leaveUs afterwards
+ * @return 1 on success, 0 if the scratch facility could not be set up,
+ *         -1 if SIM_DIRECTORY holds data the simulator did not create
+ */
+int runSimulation(const SimConfig *config, SimStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->checksum = 0xCBF29CE484222325ULL;
+    if (!makeDirectory(SIM_DIRECTORY))
+        return 0;
+
+    static Facility simulation;
+    Facility *previous = currentFacility;
+    initFacility(&simulation, "simulation", SIM_DIRECTORY);
+    currentFacility = &simulation;
+
+    // Start from an empty car park, but never wipe data the simulator did not write
+    const char *scratch[] = {FILENAME_SPOTS, FILENAME_HISTORY, FILENAME_RESERVATIONS,
+                             FILENAME_COLUMNS, FILENAME_OWNERS, FILENAME_STATEMENTS};
+    size_t scratchCount = sizeof(scratch) / sizeof(scratch[0]);
+    FILE *marker = openDataFile(FILENAME_SIM_MARKER, "r");
+    for (size_t i = 0; marker == NULL && i < scratchCount; i++)
+    {
+        FILE *existing = openDataFile(scratch[i], "r");
+        if (existing != NULL)
+        {
+            fclose(existing);
+            currentFacility = previous;
+            return -1;
+        }
+    }
+    if (marker == NULL && (marker = openDataFile(FILENAME_SIM_MARKER, "w")) != NULL)
+        fputs("Scratch car park of the simulate command; emptied on every run\n", marker);
+    if (marker == NULL)
+    {
+        currentFacility = previous;
+        return 0;
+    }
+    fclose(marker);
+    for (size_t i = 0; i < scratchCount; i++)
+        removeDataFile(scratch[i]);
+    initializeParkingSpots();
+
+    long long capacity = 4096;  // Latency slots, grown as needed
+    SimDeparture *heap = malloc(PARKING_SPOTS * sizeof(SimDeparture));
+    stats->parkUs = malloc(capacity * sizeof(unsigned));
+    stats->leaveUs = malloc(capacity * sizeof(unsigned));
+    int ok = heap != NULL && stats->parkUs != NULL && stats->leaveUs != NULL;
+
+    unsigned long long state = config->seed;
+    double end = SIM_START_TIME + (double)config->hours * 3600;
+    double arrival = simNextArrival(config, &state, SIM_START_TIME);
+    time_t last = SIM_START_TIME;
+    int parkedNow = 0, heapSize = 0;
+    double occupancySeconds = 0;
+    unsigned long long started = tickCountUs();
+
+    while (ok)
+    {
+        if (stats->parked == capacity)
+        {
+            capacity *= 2;
+            unsigned *parkUs = realloc(stats->parkUs, capacity * sizeof(unsigned));
+            unsigned *leaveUs = realloc(stats->leaveUs, capacity * sizeof(unsigned));
+            if (parkUs != NULL)
+                stats->parkUs = parkUs;
+            if (leaveUs != NULL)
+                stats->leaveUs = leaveUs;
+            ok = parkUs != NULL && leaveUs != NULL;
+            continue;
+        }
+
+        int leaving = heapSize > 0 && heap[0].time <= arrival;
+        time_t now = leaving ? heap[0].time : (time_t)arrival;
+        if (now >= end)
+            break;
+        occupancySeconds += (double)parkedNow * (now - last);
+        last = now;
+
+        CarRecord car;
+        if (leaving)
+        {
+            snprintf(car.plate, sizeof(car.plate), "SIM%07d", heap[0].car);
+            heap[0] = heap[--heapSize];
+            simHeapSiftDown(heap, heapSize, 0);
+
+            unsigned long long opStart = tickCountUs();
+            OpStatus status = leaveCar(car.plate, now, &car);
+            stats->leaveUs[stats->departures] = (unsigned)(tickCountUs() - opStart);
+            simChecksum(&stats->checksum, status);
+            if (status != OP_OK)
+            {
+                stats->failures++;
+                continue;
+            }
+            stats->departures++;
+            stats->revenue += car.fee;
+            parkedNow--;
+            continue;
+        }
+
+        int number = (int)++stats->arrivals;
+        arrival = simNextArrival(config, &state, arrival);
+        time_t stay = simDwell(config, &state);
+        snprintf(car.name, sizeof(car.name), "Sim Driver %d", number);
+        snprintf(car.plate, sizeof(car.plate), "SIM%07d", number);
+        strcpy(car.phone, "9000000000");
+        strcpy(car.address, "Simulated");
+        car.spot = 0;  // Let the allocator pick, as at an unattended gate
+
+        unsigned long long opStart = tickCountUs();
+        OpStatus status = parkCar(&car, now);
+        simChecksum(&stats->checksum, status);
+        if (status == OP_NO_VACANCY)
+        {
+            stats->turnedAway++;
+            continue;
+        }
+        if (status != OP_OK)
+        {
+            stats->failures++;
+            continue;
+        }
+        stats->parkUs[stats->parked++] = (unsigned)(tickCountUs() - opStart);
+        simChecksum(&stats->checksum, car.spot);
+        if (++parkedNow > stats->peakOccupancy)
+            stats->peakOccupancy = parkedNow;
+
+        // Every parked car holds a bay, so the heap never outgrows the spots
+        heap[heapSize].time = now + stay;
+        heap[heapSize].car = number;
+        for (int i = heapSize++; i > 0 && heap[(i - 1) / 2].time > heap[i].time; i = (i - 1) / 2)
+        {
+            SimDeparture swap = heap[i];
+            heap[i] = heap[(i - 1) / 2];
+            heap[(i - 1) / 2] = swap;
+        }
+    }
+    occupancySeconds += (double)parkedNow * (end - last);
+    stats->meanOccupancy = occupancySeconds / (end - SIM_START_TIME);
+    stats->wallUs = tickCountUs() - started;
+
+    if (ok)
+    {
+        qsort(stats->parkUs, stats->parked, sizeof(unsigned), compareLatencies);
+        qsort(stats->leaveUs, stats->departures, sizeof(unsigned), compareLatencies);
+    }
+    free(heap);
+    currentFacility = previous;
+    return ok;
+}
+
+/**
+ * Displays the exit screen
+ * 
+ * Shows the credits and a goodbye message when the application closes.
+ * The frame is left on the terminal instead of being held on a timer.
+ */
+void exitScreen()
+{
+    clearScreen();  // Clear the screen
+    setColor(12);   // Set text color to red
+    drawBorder(60, 10, 10, 5);  // Draw border for exit message
+
+    // Display credits
+    gotoxy(30, 8);
+    screenPrintf("Made by A Little Mouse");
+    
+    // Exit message
+    gotoxy(35, 12);
+    screenPrintf("Goodbye!");
+    gotoxy(0, 15);  // Leave the cursor below the frame
+    presentScreen();
+    closeScreen();
+}
+
+/**
+ * Displays ASCII art of a car at specified coordinates
+ * 
+ * @param x X-coordinate for the top-left corner of the car art
+ * @param y Y-coordinate for the top-left corner of the car art
+ */
+void displayCarArt(int x, int y)
+{
+    gotoxy(x, y++);
+    screenPrintf("   ______");        // Car roof
+    gotoxy(x, y++);
+    screenPrintf("  /|_||_\\`.__");    // Car windows and top
+    gotoxy(x, y++);
+    screenPrintf(" (   _    _ _\\");   // Car body
+    gotoxy(x, y++);
+    screenPrintf("=`-(_)--(_)-'");    // Car wheels
+}
+
+/**
+ * Counts the number of currently parked cars
+ * 
+ * Loads the parking spots and counts the occupancy bits
+ * 
+ * @return Number of currently parked cars
+ */
+int countParkedCars()
+{
+    SpotTable spots;
+    int count = loadSpotTable(&spots) ? countOccupiedSpots(&spots) : 0;  // Sets the gauge
+    freeSpotTable(&spots);
+    return count;
+}
+
+/**
+ * Draws the "Cars Parked" counter of the main menu
+ *
+ * Also called by the live key wait whenever the spots file changes.
+ */
+void drawParkedCount()
+{
+    gotoxy(25, 20);
+    screenPrintf("Cars Parked: %-3d", countParkedCars());
+}
+
+/**
+ * Displays the main menu with all available options
+ * 
+ * Shows the main menu interface with car art and current parking status
+ */
+void mainMenu()
+{
+    clearScreen();  // Clear the screen
+    setColor(10);   // Set text color to green
+    drawBorder(60, 20, 10, 3);  // Draw border for menu
+    displayCarArt(20, 5);  // Display car ASCII art
+    
+    // Display menu title and options
+    gotoxy(30, 8);
+    screenPrintf("MAIN MENU");
+    gotoxy(25, 10);
+    screenPrintf("1. Display Parking Status");
+    gotoxy(25, 11);
+    screenPrintf("2. Add Car");
+    gotoxy(25, 12);
+    screenPrintf("3. Remove Car");
+    gotoxy(25, 13);
+    screenPrintf("4. Search Records");
+    gotoxy(25, 14);
+    screenPrintf("5. Exit System");
+
+    // Prompt for user input
+    gotoxy(25, 16);
+    screenPrintf("Enter your choice (1-5): ");
+    
+    // Display current parking status
+    drawParkedCount();
+
+    // Display message left by the previous screen, if any
+    showPostedNotice(25, 18);
+    
+    // Position cursor at input position
+    gotoxy(50,16);
+}
+
+/**
+ * Draws the parking spot grid and occupancy line from the spots file
+ *
+ * Used for the initial draw and again whenever the spots file changes;
+ * the renderer then only repaints bays whose state differs.
+ */
+void drawParkingGrid()
+{
+    ReservationBook *book = &currentFacility->reservations;
+    // Load all parking spots data into memory
+    SpotTable spots;
+    if (!loadSpotTable(&spots))
+    {
+        freeSpotTable(&spots);
+        gotoxy(12, 5);
+        setColor(12);
+        screenPrintf("Error loading parking data!");
+        return;
+    }
+
+    // Display parking spots in a grid layout (10x10); only the occupancy bits are read
+    int occupied = countOccupiedSpots(&spots);
+    time_t now = time(NULL);
+    mutexLock(&book->lock);
+    refreshReservations(book);
+    for (int spot = 1; spot <= spots.count; spot++)
+    {
+        // Calculate position in grid (10 columns)
+        int row = 8 + ((spot - 1) / 10) * 2;  // New row every 10 spots, with spacing
+        int col = 10 + ((spot - 1) % 10) * 7; // 7 characters width per spot
+
+        gotoxy(col, row);
+        if (spotOccupied(&spots, spot))
+        {
+            setColor(12);  // Red for occupied spots
+            screenPrintf("[ X ]");
+        }
+        else
+        {
+            // Yellow for spots held for a booking, green for available spots
+            setColor(spotHeld(book, spot, NULL, now) ? 14 : 10);
+            screenPrintf("[%3d]", spot);
+        }
+    }
+    mutexUnlock(&book->lock);
+    freeSpotTable(&spots);
+
+    // Display live occupancy and time of the last refresh
+    struct tm *local = localtime(&now);
+    setColor(11);
+    gotoxy(12, 5);
+    screenPrintf("Occupied: %3d/%d   Free: %3d", occupied, PARKING_SPOTS,
+                 PARKING_SPOTS - occupied);
+    gotoxy(60, 5);
+    screenPrintf("LIVE  %02d:%02d:%02d", local->tm_hour, local->tm_min, local->tm_sec);
+}
+
+/**
+ * Displays the current status of all parking spots
+ * 
+ * Shows a visual grid of all parking spots with their status (occupied or available)
+ * Occupied spots are shown in red with [X], available spots show their spot number in green
+ */
+void displayParkingStatus()
+{
+    clearScreen();  // Clear the screen
+    setColor(15);   // Set text color to white
+    drawBorder(82, 27, 5, 2);  // Draw border for parking display
+    
+    // Ensure parking spots file exists
+    initializeParkingSpots();
+
+    // Display title
+    gotoxy(40, 4);
+    screenPrintf("PARKING STATUS");
+
+    // Display grid, then keep it updated until a key is pressed
+    drawParkingGrid();
+
+    // Prompt to return to main menu
+    setColor(15);  // White text
+    gotoxy(10, 27);
+    screenPrintf("Press any key to return to main menu...");
+    readKeyLive(0, drawParkingGrid);  // Wait for key press, redrawing on changes
+}
+
+/**
+ * Adds a new car to the parking system
+ * 
+ * Collects car and owner information, validates input data,
+ * assigns a parking spot, and updates both the parking spots
+ * and history files
+ */
+void addCar()
+{
+    clearScreen();  // Clear the screen
+    drawBorder(60, 20, 10, 3);  // Draw border for input form
+    displayCarArt(20, 5);  // Display car ASCII art
+    
+    CarRecord newCar;  // Structure to store new car information
+    time_t now = time(NULL);  // Current timestamp
+    gotoxy(25, 8);
+    screenPrintf("ADD NEW CAR ENTRY");
+
+    // Get Owner Name
+    do
+    {
+        gotoxy(20, 10);
+        screenPrintf("Owner Name:            ");
+        gotoxy(33, 10);
+        readLine(newCar.name, 50);
+        if (strlen(newCar.name) == 0)
+            flashMessage(20, 16, 12, "Name cannot be empty!");
+    } while (strlen(newCar.name) == 0);
+
+    // Check for existing plates
+    SpotTable spots;
+    if (!loadSpotTable(&spots))
+    {
+        freeSpotTable(&spots);
+        postNotice(12, "Error loading parking data!");
+        return;
+    }
+
+    // Get License Plate
+    int plateExists = 0;
+    do
+    {
+        plateExists = 0;
+        gotoxy(20, 11);
+        screenPrintf("License Plate:          ");
+        gotoxy(35, 11);
+        readLine(newCar.plate, 20);
+
+        plateExists = findParkedSpot(&spots, newCar.plate) != 0;
+        if (plateExists)
+        {
+            freeSpotTable(&spots);
+            postNotice(12, "Car already parked!");
+            return;
+        }
+        else if (strlen(newCar.plate) == 0)
+            flashMessage(20, 16, 12, "Plate cannot be empty!");
+    } while (strlen(newCar.plate) == 0);
+
+    // Get Phone Number
+    int validPhone = 0;
+    setColor(10);
+    do
+    {
+        gotoxy(20, 12);
+        screenPrintf("Phone Number:          ");
+        gotoxy(35, 12);
+        readLine(newCar.phone, 15);
+
+        validPhone = isValidPhone(newCar.phone);
+        if (!validPhone)
+            flashMessage(20, 16, 12, "Invalid phone! 10 digits required!");
+    } while (!validPhone);
+
+    // Get Address
+    setColor(10);
+    do
+    {
+        gotoxy(20, 13);
+        screenPrintf("Address:             ");
+        gotoxy(30, 13);
+        readLine(newCar.address, 100);
+        if (strlen(newCar.address) == 0)
+            flashMessage(20, 16, 12, "Address cannot be empty!");
+    } while (strlen(newCar.address) == 0);
+
+    // Get Parking Spot
+    int valid = 0;
+    char input[10];
+    setColor(10);
+    do
+    {
+        gotoxy(20, 14);
+        screenPrintf("Spot (1-100, 0=any): ");
+        gotoxy(41, 14);
+        screenPrintf("      ");
+        gotoxy(41, 14);
+        readLine(input, 10);
+        if (sscanf(input, "%d", &newCar.spot) != 1)
+        {
+            flashMessage(20, 16, 12, "Invalid number input!");
+            continue;
+        }
+
+        valid = newCar.spot == 0 ||  // Let parkCar() pick a bay
+                (newCar.spot >= 1 && newCar.spot <= spots.count && !spotOccupied(&spots, newCar.spot));
+
+        if (!valid)
+            flashMessage(20, 16, 12, "Invalid or occupied spot!");
+        else if (newCar.spot != 0)
+        {
+            mutexLock(&currentFacility->reservations.lock);
+            refreshReservations(&currentFacility->reservations);
+            valid = !spotHeld(&currentFacility->reservations, newCar.spot, newCar.plate, now);
+            mutexUnlock(&currentFacility->reservations.lock);
+            if (!valid)
+                flashMessage(20, 16, 12, "Spot is reserved!");
+        }
+    } while (!valid);
+    freeSpotTable(&spots);
+
+    // Validate once more against current state and commit the entry
+    OpStatus status = parkCar(&newCar, now);
+    if (status != OP_OK)
+    {
+        gotoxy(20, 16);
+        setColor(12);
+        screenPrintf("%s", opStatusMessage(status));
+        gotoxy(20, 17);
+        screenPrintf("Press any key to return...");
+        readKey(0);
+        return;
+    }
+
+    gotoxy(20, 16);
+    setColor(10);
+    screenPrintf("Entry added successfully! Spot %d", newCar.spot);
+    gotoxy(20, 17);
+    screenPrintf("Press any key to return...");
+    readKey(0);
+}
+
+/**
+ * Removes a car from the parking system
+ * 
+ * Gets the license plate of the car to remove, calculates parking fee,
+ * updates parking spots and history files, and displays a receipt
+ */
+void removeCar()
+{
+    clearScreen();  // Clear the screen
+    setColor(15);   // Set text color to white
+    drawBorder(60, 20, 10, 3);  // Draw border for form
+    displayCarArt(20, 5);  // Display car ASCII art
+
+    // Check if there are any parked cars
+    int parkedCars = countParkedCars();
+    if (parkedCars == 0)
+    {
+        postNotice(12, "No cars parked!");
+        return;
+    }
+
+    char plate[20];
+    time_t exit_time = time(NULL);
+    gotoxy(25, 8);
+    screenPrintf("REMOVE CAR FROM PARKING");
+
+    // Get license plate
+    do
+    {
+        gotoxy(20, 10);
+        screenPrintf("Enter License Plate: ");
+        gotoxy(40, 10);
+        screenPrintf("                    ");
+        gotoxy(40, 10);
+        readLine(plate, 20);
+        if (strlen(plate) == 0)
+            flashMessage(20, 12, 12, "Plate cannot be empty!");
+    } while (strlen(plate) == 0);
+
+    // Find the car, free its spot and close its history row
+    CarRecord receipt;
+    OpStatus status = leaveCar(plate, exit_time, &receipt);
+    if (status == OP_NOT_PARKED)
+    {
+        // Likely a misread plate: offer the closest parked plates
+        PlateCandidates candidates;
+        refreshPlateIndex(&currentFacility->plateIndex);
+        lookupPlates(&currentFacility->plateIndex, plate, 1, &candidates);
+        if (candidates.count > 0)
+        {
+            gotoxy(20, 12);
+            setColor(14);
+            screenPrintf("Not parked. Did you mean:");
+            for (int i = 0; i < candidates.count; i++)
+            {
+                gotoxy(22, 13 + i);
+                screenPrintf("%d. %-20s (spot %d)", i + 1, candidates.matches[i].plate,
+                             candidates.matches[i].spot);
+            }
+            gotoxy(20, 19);
+            screenPrintf("Press 1-%d to remove it, any other key to cancel", candidates.count);
+
+            int key = readKey(0);
+            if (key < '1' || key >= '1' + candidates.count)
+                return;
+            strcpy(plate, candidates.matches[key - '1'].plate);
+            status = leaveCar(plate, exit_time, &receipt);
+
+            setColor(15);
+            for (int y = 12; y <= 19; y++)
+            {
+                gotoxy(20, y);
+                screenPrintf("%-49s", "");
+            }
+        }
+    }
+    if (status != OP_OK)
+    {
+        postNotice(12, opStatusMessage(status));
+        return;
+    }
+    time_t entry_time = receipt.entry_time;
+    double fee = receipt.fee;
+
+    // Display receipt
+    gotoxy(20, 12);
+    setColor(10);
+    screenPrintf("Car removed successfully!");
+    gotoxy(20, 13);
+    screenPrintf("Entry Time:  %s", ctime(&entry_time));
+    gotoxy(20, 14);
+    screenPrintf("Exit Time:   %s", ctime(&exit_time));
+    gotoxy(20, 15);
+    screenPrintf("Parking Duration: %lld seconds", (long long)(exit_time - entry_time));
+    gotoxy(20, 16);
+    screenPrintf("Total Fee:   Rs,%.2f (Rs,0.03/sec)", fee);
+    gotoxy(20, 18);
+    screenPrintf("Press any key to return...");
+    readKey(0);
+}
+
+/**
+ * Searches parking history by owner name
+ * 
+ * Finds all parking records for a specific owner and displays
+ * summary information including total entries and unique vehicles
+ */
+void searchByName()
+{
+    clearScreen();  // Clear the screen
+    char name[50];  // Buffer for owner name input
+    drawBorder(60, 25, 10, 3);  // Draw border for search form
+    displayCarArt(20, 5);  // Display car ASCII art
+
+    gotoxy(25, 8);
+    screenPrintf("SEARCH BY OWNER NAME");
+
+    // Get name with validation
+    do
+    {
+        gotoxy(20, 10);
+        screenPrintf("Enter Owner Name: ");
+        gotoxy(38, 10);
+        screenPrintf("                    ");
+        gotoxy(38, 10);
+        readLine(name, 50);
+        if (strlen(name) == 0)
+            flashMessage(20, 12, 12, "Name cannot be empty!");
+    } while (strlen(name) == 0);
+
+    SearchResult result;
+    if (!searchHistory(SEARCH_BY_NAME, name, &result))
+    {
+        gotoxy(20, 12);
+        screenPrintf("No history records found!");
+        readKey(0);
+        return;
+    }
+
+    gotoxy(20, 12);
+    screenPrintf("Parking History for: %s", name);
+    gotoxy(20, 13);
+    screenPrintf("Total Times Parked: %d", result.totalEntries);
+    gotoxy(20, 14);
+    screenPrintf("Unique Vehicles: %d", result.count);
+
+    gotoxy(20, 16);
+    screenPrintf("License Plates Used:");
+    for (int i = 0; i < result.count; i++)
+    {
+        gotoxy(22, 17 + i);
+        screenPrintf("%d. %s", i + 1, result.matches[i]);
+    }
+
+    gotoxy(20, 22);
+    screenPrintf("Press any key to return...");
+    readKey(0);
+}
+
+/**
+ * Searches parking history by license plate
+ * 
+ * Finds all parking records for a specific vehicle and displays
+ * summary information including total entries and all registered owners
+ */
+void searchByPlate()
+{
+    clearScreen();  // Clear the screen
+    char plate[20]; // Buffer for license plate input
+    drawBorder(60, 25, 10, 3);  // Draw border for search form
+    displayCarArt(20, 5);  // Display car ASCII art
+
+    gotoxy(25, 8);
+    screenPrintf("SEARCH BY LICENSE PLATE");
+
+    // Get plate with validation
+    do
+    {
+        gotoxy(20, 10);
+        screenPrintf("Enter License Plate: ");
+        gotoxy(40, 10);
+        screenPrintf("                    ");
+        gotoxy(40, 10);
+        readLine(plate, 20);
+        if (strlen(plate) == 0)
+            flashMessage(20, 12, 12, "Plate cannot be empty!");
+    } while (strlen(plate) == 0);
+
+    SearchResult result;
+    if (!searchHistory(SEARCH_BY_PLATE, plate, &result))
+    {
+        gotoxy(20, 12);
+        screenPrintf("No history records found!");
+        readKey(0);
+        return;
+    }
+
+    if (result.totalEntries == 0)
+    {
+        // No exact match: list similar plates instead
+        PlateCandidates candidates;
+        refreshPlateIndex(&currentFacility->plateIndex);
+        lookupPlates(&currentFacility->plateIndex, plate, 0, &candidates);
+
+        gotoxy(20, 12);
+        screenPrintf("No records for: %s", plate);
+        if (candidates.count > 0)
+        {
+            gotoxy(20, 14);
+            screenPrintf("Similar plates:");
+            for (int i = 0; i < candidates.count; i++)
+            {
+                gotoxy(22, 15 + i);
+                if (candidates.matches[i].spot)
+                    screenPrintf("%d. %-20s parked in spot %d", i + 1, candidates.matches[i].plate,
+                                 candidates.matches[i].spot);
+                else
+                    screenPrintf("%d. %-20s %d visit(s)", i + 1, candidates.matches[i].plate,
+                                 candidates.matches[i].visits);
+            }
+        }
+        gotoxy(20, 22);
+        screenPrintf("Press any key to return...");
+        readKey(0);
+        return;
+    }
+
+    gotoxy(20, 12);
+    screenPrintf("Parking History for: %s", plate);
+    gotoxy(20, 13);
+    screenPrintf("Total Entries: %d", result.totalEntries);
+
+    gotoxy(20, 15);
+    screenPrintf("Registered Owners:");
+    for (int i = 0; i < result.count; i++)
+    {
+        gotoxy(22, 16 + i);
+        screenPrintf("%d. %s", i + 1, result.matches[i]);
+    }
+
+    gotoxy(20, 22);
+    screenPrintf("Press any key to return...");
+    readKey(0);
+}
+
+/**
+ * Displays the search menu with options to search by name or license plate
+ * 
+ * Provides a submenu for different search options and handles user input
+ */
+void searchMenu()
+{
+    char choice;
+    do
+    {
+        clearScreen();  // Clear the screen
+        setColor(11);   // Set text color to cyan
+        drawBorder(60, 20, 10, 3);  // Draw border for menu
+        displayCarArt(20, 5);  // Display car ASCII art
+
+        // Display search menu options
+        gotoxy(30, 8);
+        screenPrintf("SEARCH MENU");
+        gotoxy(25, 10);
+        screenPrintf("1. Search by Owner Name");
+        gotoxy(25, 11);
+        screenPrintf("2. Search by License Plate");
+        gotoxy(25, 12);
+        screenPrintf("3. Return to Main Menu");
+        gotoxy(25, 14);
+        screenPrintf("Enter your choice (1-3): ");
+        showPostedNotice(25, 16);  // Message left by the previous choice
+
+        // Get user choice and process it
+        choice = readKey(1);  // Get character without waiting for Enter
+
+        // Handle user selection
+        switch (choice)
+        {
+        case '1':
+            searchByName();  // Search records by owner name
+            break;
+        case '2':
+            searchByPlate(); // Search records by license plate
+            break;
+        case '3':
+            return;  // Return to main menu
+        default:
+            postNotice(12, "Invalid choice!");
+        }
+    } while (choice != '3');  // Continue until user chooses to return
+}
+
+/**
+ * Prints a string as a JSON string literal
+ *
+ * @param text Text to quote
+ */
+void printJsonString(const char *text)
+{
+    putchar('"');
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            printf("\\%c", *p);
+        else if (*p < 0x20)
+            printf("\\u%04x", *p);
+        else
+            putchar(*p);
+    }
+    putchar('"');
+}
+
+/**
+ * Prints the result of a failed command as JSON
+ *
+ * @param status Reason the command failed
+ * @return Process exit code for the failure
+ */
+int printCommandError(OpStatus status)
+{
+    printf("{\"ok\":false,\"error\":\"%s\",\"message\":", opStatusCode(status));
+    printJsonString(opStatusMessage(status));
+    printf("}\n");
+    return status == OP_IO_ERROR ? 3 : 2;
+}
+
+/**
+ * park <name> <plate> <phone> <address> <spot|0>
+ *
+ * @return Process exit code
+ */
+int commandPark(int argc, char *argv[])
+{
+    if (argc != 7)
+        return -1;
+
+    CarRecord car;
+    snprintf(car.name, sizeof(car.name), "%s", argv[2]);
+    snprintf(car.plate, sizeof(car.plate), "%s", argv[3]);
+    snprintf(car.phone, sizeof(car.phone), "%s", argv[4]);
+    snprintf(car.address, sizeof(car.address), "%s", argv[5]);
+    if (sscanf(argv[6], "%d", &car.spot) != 1)
+        return printCommandError(OP_INVALID_SPOT);
+
+    OpStatus status = parkCar(&car, time(NULL));
+    if (status != OP_OK)
+        return printCommandError(status);
+
+    printf("{\"ok\":true,\"plate\":");
+    printJsonString(car.plate);
+    printf(",\"spot\":%d,\"entry_time\":%ld}\n", car.spot, (long)car.entry_time);
+    return 0;
+}
+
+/**
+ * leave <plate>
+ *
+ * @return Process exit code
+ */
+int commandLeave(int argc, char *argv[])
+{
+    if (argc != 3)
+        return -1;
+
+    CarRecord receipt;
+    OpStatus status = leaveCar(argv[2], time(NULL), &receipt);
+    if (status != OP_OK)
+        return printCommandError(status);
+
+    printf("{\"ok\":true,\"plate\":");
+    printJsonString(receipt.plate);
+    printf(",\"spot\":%d,\"entry_time\":%ld,\"exit_time\":%ld,\"duration\":%lld,\"fee\":%.2f}\n",
+           receipt.spot, (long)receipt.entry_time, (long)receipt.exit_time,
+           (long long)(receipt.exit_time - receipt.entry_time), receipt.fee);
+    return 0;
+}
+
+/**
+ * lookup-owner <name> / lookup-plate <plate>
+ *
+ * @param field SEARCH_BY_NAME or SEARCH_BY_PLATE
+ * @return Process exit code
+ */
+int commandLookup(int argc, char *argv[], SearchField field)
+{
+    if (argc != 3)
+        return -1;
+
+    SearchResult result;
+    searchHistory(field, argv[2], &result);  // No history file: zero matches
+
+    printf("{\"ok\":true,\"%s\":", field == SEARCH_BY_NAME ? "owner" : "plate");
+    printJsonString(argv[2]);
+    printf(",\"total_entries\":%d,\"%s\":[", result.totalEntries,
+           field == SEARCH_BY_NAME ? "plates" : "owners");
+    for (int i = 0; i < result.count; i++)
+    {
+        if (i > 0)
+            putchar(',');
+        printJsonString(result.matches[i]);
+    }
+    printf("]}\n");
+    return 0;
+}
+
+/**
+ * find-plate <plate> [--parked]
+ *
+ * @return Process exit code
+ */
+int commandFindPlate(int argc, char *argv[])
+{
+    int parkedOnly = argc == 4 && strcmp(argv[3], "--parked") == 0;
+    if (argc != 3 && !parkedOnly)
+        return -1;
+
+    PlateCandidates candidates;
+    refreshPlateIndex(&currentFacility->plateIndex);
+    lookupPlates(&currentFacility->plateIndex, argv[2], parkedOnly, &candidates);
+
+    printf("{\"ok\":true,\"query\":");
+    printJsonString(argv[2]);
+    printf(",\"candidates\":[");
+    for (int i = 0; i < candidates.count; i++)
+    {
+        const PlateMatch *match = &candidates.matches[i];
+        printf("%s{\"plate\":", i ? "," : "");
+        printJsonString(match->plate);
+        printf(",\"match\":\"%s\",\"cost\":%d,\"parked\":%s,\"spot\":%d,\"visits\":%d}",
+               match->cost == 0 ? "exact" : match->prefix ? "prefix" : "fuzzy", match->cost,
+               match->spot ? "true" : "false", match->spot, match->visits);
+    }
+    printf("]}\n");
+    return 0;
+}
+
+/**
+ * occupancy
+ *
+ * @return Process exit code
+ */
+int commandOccupancy(int argc, char *argv[])
+{
+    (void)argv;
+    if (argc != 2)
+        return -1;
+
+    SpotTable spots;
+    if (!loadSpotTable(&spots))
+    {
+        freeSpotTable(&spots);
+        return printCommandError(OP_IO_ERROR);
+    }
+
+    int occupied = countOccupiedSpots(&spots);
+    printf("{\"ok\":true,\"total\":%d,\"occupied\":%d,\"free\":%d,\"parked\":[",
+           spots.count, occupied, spots.count - occupied);
+    int first = 1;
+    for (int spot = nextOccupiedSpot(&spots, 0); spot != 0; spot = nextOccupiedSpot(&spots, spot))
+    {
+        printf("%s{\"spot\":%d,\"plate\":", first ? "" : ",", spot);
+        printJsonString(spots.plates[spot - 1]);
+        printf(",\"entry_time\":%ld}", (long)spots.entryTimes[spot - 1]);
+        first = 0;
+    }
+    printf("]}\n");
+    freeSpotTable(&spots);
+    return 0;
+}
+
+/**
+ * Parses a "YYYY-MM-DD HH:MM" (or "YYYY-MM-DDTHH:MM") local time
+ *
+ * @param text Date and time text
+ * @param result Receives the time
+ * @return 1 on success, 0 if the text is malformed
+ */
+int parseDateTime(const char *text, time_t *result)
+{
+    struct tm date = {0};
+    char separator, extra;
+    if (sscanf(text, "%d-%d-%d%c%d:%d%c", &date.tm_year, &date.tm_mon, &date.tm_mday,
+               &separator, &date.tm_hour, &date.tm_min, &extra) != 6 ||
+        (separator != ' ' && separator != 'T'))
+        return 0;
+    if (date.tm_mon < 1 || date.tm_mon > 12 || date.tm_mday < 1 || date.tm_mday > 31 ||
+        date.tm_hour < 0 || date.tm_hour > 23 || date.tm_min < 0 || date.tm_min > 59)
+        return 0;
+
+    date.tm_year -= 1900;
+    date.tm_mon -= 1;
+    date.tm_isdst = -1;
+    *result = mktime(&date);
+    return *result != (time_t)-1;
+}
+
+/**
+ * Reads an optional trailing "--level N"
+ *
+ * @param argc Argument count
+ * @param argv Arguments
+ * @param first Index where the option may start
+ * @param level Receives the level (left alone if the option is absent)
+ * @return 1 if the arguments are valid, 0 otherwise
+ */
+int parseLevelOption(int argc, char *argv[], int first, int *level)
+{
+    if (argc == first)
+        return 1;
+    return argc == first + 2 && strcmp(argv[first], "--level") == 0 &&
+           sscanf(argv[first + 1], "%d", level) == 1 && *level >= 1 && *level <= PARKING_LEVELS;
+}
+
+/**
+ * reserve <plate> <spot|0> <from> <to> [--level N]
+ *
+ * @return Process exit code
+ */
+int commandReserve(int argc, char *argv[])
+{
+    int spot, level = 0;
+    time_t from, to;
+    if (argc < 6 || !parseLevelOption(argc, argv, 6, &level) || sscanf(argv[3], "%d", &spot) != 1)
+        return -1;
+    if (!parseDateTime(argv[4], &from) || !parseDateTime(argv[5], &to))
+        return printCommandError(OP_INVALID_TIME);
+
+    Reservation booked;
+    int bookedSpot;
+    OpStatus status = reserveSpot(argv[2], spot, level, from, to, &booked, &bookedSpot);
+    if (status != OP_OK)
+        return printCommandError(status);
+
+    printf("{\"ok\":true,\"id\":%d,\"plate\":", booked.id);
+    printJsonString(booked.plate);
+    printf(",\"spot\":%d,\"level\":%d,\"from\":%ld,\"to\":%ld}\n",
+           bookedSpot, spotLevel(bookedSpot), (long)booked.start, (long)booked.end);
+    return 0;
+}
+
+/**
+ * cancel-reservation <id>
+ *
+ * @return Process exit code
+ */
+int commandCancelReservation(int argc, char *argv[])
+{
+    int id;
+    if (argc != 3 || sscanf(argv[2], "%d", &id) != 1)
+        return -1;
+
+    OpStatus status = cancelReservation(id);
+    if (status != OP_OK)
+        return printCommandError(status);
+    printf("{\"ok\":true,\"id\":%d}\n", id);
+    return 0;
+}
+
+/**
+ * availability <from> <to> [--level N]
+ *
+ * @return Process exit code
+ */
+int commandAvailability(int argc, char *argv[])
+{
+    ReservationBook *book = &currentFacility->reservations;
+    int level = 0;
+    time_t from, to;
+    if (argc < 4 || !parseLevelOption(argc, argv, 4, &level))
+        return -1;
+    if (!parseDateTime(argv[2], &from) || !parseDateTime(argv[3], &to) || to <= from)
+        return printCommandError(OP_INVALID_TIME);
+
+    SpotTable spots;
+    if (!loadSpotTable(&spots))
+    {
+        freeSpotTable(&spots);
+        return printCommandError(OP_IO_ERROR);
+    }
+
+    int freeSpots[PARKING_SPOTS];
+    mutexLock(&book->lock);
+    refreshReservations(book);
+    int count = findAvailableSpots(book, &spots, level, from, to, time(NULL), freeSpots);
+    int bookings = book->count;
+    mutexUnlock(&book->lock);
+    freeSpotTable(&spots);
+
+    int perLevel[PARKING_LEVELS + 1] = {0};
+    for (int i = 0; i < count; i++)
+        perLevel[spotLevel(freeSpots[i])]++;
+
+    printf("{\"ok\":true,\"from\":%ld,\"to\":%ld,\"level\":%d,\"bookings\":%d,\"free\":%d,\"levels\":[",
+           (long)from, (long)to, level, bookings, count);
+    for (int l = 1; l <= PARKING_LEVELS; l++)
+        printf("%s%d", l > 1 ? "," : "", perLevel[l]);
+    printf("],\"spots\":[");
+    for (int i = 0; i < count; i++)
+        printf("%s%d", i ? "," : "", freeSpots[i]);
+    printf("]}\n");
+    return 0;
+}
+
+/**
+ * where-is <plate>
+ *
+ * Asks every facility in parallel.
+ *
+ * @return Process exit code
+ */
+int commandWhereIs(int argc, char *argv[])
+{
+    if (argc != 3)
+        return -1;
+
+    PlateWhereabouts answers[MAX_FACILITIES];
+    for (int i = 0; i < facilityCount; i++)
+        answers[i].plate = argv[2];
+    fanOut(locatePlate, answers, sizeof(PlateWhereabouts));
+
+    printf("{\"ok\":true,\"plate\":");
+    printJsonString(argv[2]);
+    printf(",\"parked\":[");
+    int first = 1;
+    for (int i = 0; i < facilityCount; i++)
+    {
+        if (answers[i].spot == 0)
+            continue;
+        printf("%s{\"facility\":", first ? "" : ",");
+        printJsonString(facilities[i]->id);
+        printf(",\"plate\":");
+        printJsonString(answers[i].parkedPlate);
+        printf(",\"spot\":%d,\"entry_time\":%ld}", answers[i].spot, (long)answers[i].entryTime);
+        first = 0;
+    }
+    printf("],\"similar\":[");
+    int found = !first;  // Misread suggestions only when the plate is parked nowhere
+    first = 1;
+    for (int i = 0; i < facilityCount && !found; i++)
+    {
+        for (int m = 0; m < answers[i].similar.count; m++)
+        {
+            const PlateMatch *match = &answers[i].similar.matches[m];
+            printf("%s{\"facility\":", first ? "" : ",");
+            printJsonString(facilities[i]->id);
+            printf(",\"plate\":");
+            printJsonString(match->plate);
+            printf(",\"spot\":%d,\"cost\":%d}", match->spot, match->cost);
+            first = 0;
+        }
+    }
+    printf("],\"unreadable\":[");
+    first = 1;
+    for (int i = 0; i < facilityCount; i++)
+    {
+        if (answers[i].ok)
+            continue;
+        printf("%s", first ? "" : ",");
+        printJsonString(facilities[i]->id);
+        first = 0;
+    }
+    printf("]}\n");
+    return 0;
+}
+
+/**
+ * group-occupancy
+ *
+ * Asks every facility in parallel.
+ *
+ * @return Process exit code
+ */
+int commandGroupOccupancy(int argc, char *argv[])
+{
+    (void)argv;
+    if (argc != 2)
+        return -1;
+
+    FacilityOccupancy answers[MAX_FACILITIES];
+    fanOut(measureOccupancy, answers, sizeof(FacilityOccupancy));
+
+    int occupied = 0, held = 0, total = 0;
+    printf("{\"ok\":true,\"facilities\":[");
+    for (int i = 0; i < facilityCount; i++)
+    {
+        printf("%s{\"id\":", i ? "," : "");
+        printJsonString(facilities[i]->id);
+        if (!answers[i].ok)
+        {
+            printf(",\"error\":\"%s\"}", opStatusCode(OP_IO_ERROR));
+            continue;
+        }
+        printf(",\"total\":%d,\"occupied\":%d,\"held\":%d,\"free\":%d}", PARKING_SPOTS,
+               answers[i].occupied, answers[i].held, PARKING_SPOTS - answers[i].occupied);
+        occupied += answers[i].occupied;
+        held += answers[i].held;
+        total += PARKING_SPOTS;
+    }
+    printf("],\"total\":%d,\"occupied\":%d,\"held\":%d,\"free\":%d}\n",
+           total, occupied, held, total - occupied);
+    return 0;
+}
+
+/**
+ * export-columns
+ *
+ * @return Process exit code
+ */
+int commandExportColumns(int argc, char *argv[])
+{
+    (void)argv;
+    if (argc != 2)
+        return -1;
+
+    ColumnStoreHeader stats;
+    if (!exportHistoryColumns(&stats))
+        return printCommandError(OP_IO_ERROR);
+
+    printf("{\"ok\":true,\"sessions\":%llu,\"owners\":%d,\"from\":%lld,\"to\":%lld}\n",
+           (unsigned long long)stats.rows, stats.owners,
+           (long long)(stats.rows ? stats.minTime : 0), (long long)(stats.rows ? stats.maxTime : 0));
+    return 0;
+}
+
+/**
+ * Parses a YYYY-MM-DD or YYYY-MM date as local midnight
+ *
+ * @param text Date text
+ * @param days Days to add after parsing
+ * @param months Months to add after parsing
+ * @param result Receives the time
+ * @return 1 on success, 0 if the date is malformed
+ */
+int parseReportDate(const char *text, int days, int months, time_t *result)
+{
+    struct tm date = {0};
+    int day = 1;
+    char extra;
+    int fields = sscanf(text, "%d-%d-%d%c", &date.tm_year, &date.tm_mon, &day, &extra);
+    if (fields != 2 && fields != 3)
+        return 0;
+    if (date.tm_mon < 1 || date.tm_mon > 12 || day < 1 || day > 31)
+        return 0;
+
+    date.tm_year -= 1900;
+    date.tm_mon += months - 1;
+    date.tm_mday = day + days;
+    date.tm_isdst = -1;
+    *result = mktime(&date);
+    return *result != (time_t)-1;
+}
+
+/**
+ * Prints the sessions/revenue/dwell fields shared by report rows
+ *
+ * @param totals Report aggregates
+ * @param k Report key
+ */
+void printReportCell(const ReportTotals *totals, int k)
+{
+    printf("\"sessions\":%lld,\"revenue\":%.2f,\"avg_dwell_minutes\":%.1f",
+           (long long)totals->sessions[k], totals->revenue[k] / 100.0,
+           totals->sessions[k] ? totals->seconds[k] / 60.0 / totals->sessions[k] : 0.0);
+}
+
+/**
+ * Finds a dwell-time percentile from the per-minute histogram
+ *
+ * @param totals Dwell report aggregates
+ * @param fraction Percentile as a fraction (0.5 = median)
+ * @return Dwell in minutes (DWELL_MAX_MINUTES means "a week or more")
+ */
+int dwellPercentile(const ReportTotals *totals, double fraction)
+{
+    int64_t target = (int64_t)ceil(totals->totalSessions * fraction);
+    int64_t seen = 0;
+    for (int k = 0; k < totals->keys; k++)
+    {
+        seen += totals->sessions[k];
+        if (seen >= target && seen > 0)
+            return k;
+    }
+    return 0;
+}
+
+/**
+ * report daily|hourly|level|dwell|turnover [--month YYYY-MM] [--from YYYY-MM-DD] [--to YYYY-MM-DD]
+ *
+ * Reads the column store, exporting it first if it does not exist yet.
+ * Date filters apply to the exit time; --to is inclusive.
+ *
+ * @return Process exit code
+ */
+int commandReport(int argc, char *argv[])
+{
+    static const char *kinds[] = {"daily", "hourly", "level", "dwell", "turnover"};
+    if (argc < 3)
+        return -1;
+
+    int kind = -1;
+    for (int i = 0; i < 5; i++)
+    {
+        if (strcmp(argv[2], kinds[i]) == 0)
+            kind = i;
+    }
+    if (kind < 0)
+        return -1;
+
+    time_t from = 0, to = 0;
+    for (int i = 3; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            return -1;
+        if (strcmp(argv[i], "--month") == 0)
+        {
+            if (!parseReportDate(argv[i + 1], 0, 0, &from) || !parseReportDate(argv[i + 1], 0, 1, &to))
+                return -1;
+        }
+        else if (strcmp(argv[i], "--from") == 0)
+        {
+            if (!parseReportDate(argv[i + 1], 0, 0, &from))
+                return -1;
+        }
+        else if (strcmp(argv[i], "--to") == 0)
+        {
+            if (!parseReportDate(argv[i + 1], 1, 0, &to))
+                return -1;
+        }
+        else
+            return -1;
+    }
+
+    if (columnStoreStale() && !exportHistoryColumns(NULL))
+        return printCommandError(OP_IO_ERROR);
+
+    ReportTotals totals;
+    if (!runReport((ReportKind)kind, from, to, &totals))
+        return printCommandError(OP_IO_ERROR);
+
+    printf("{\"ok\":true,\"report\":\"%s\",\"sessions\":%lld,\"revenue\":%.2f,\"rows\":[",
+           kinds[kind], (long long)totals.totalSessions, totals.totalRevenue / 100.0);
+
+    int first = 1;
+    switch ((ReportKind)kind)
+    {
+    case REPORT_DAILY:
+        for (int k = 0; k < totals.keys; k++)
+        {
+            if (totals.sessions[k] == 0)
+                continue;
+            // Noon of the local day, so DST changes cannot move it to another date
+            time_t noon = (time_t)(totals.firstDay + k) * 86400 - totals.utcOffset + 43200;
+            char date[16];
+            strftime(date, sizeof(date), "%Y-%m-%d", localtime(&noon));
+            printf("%s{\"date\":\"%s\",", first ? "" : ",", date);
+            printReportCell(&totals, k);
+            putchar('}');
+            first = 0;
+        }
+        break;
+    case REPORT_HOURLY:
+        for (int k = 0; k < totals.keys; k++)
+        {
+            printf("%s{\"hour\":%d,", k ? "," : "", k);
+            printReportCell(&totals, k);
+            putchar('}');
+        }
+        break;
+    case REPORT_LEVEL:
+        for (int k = 1; k < totals.keys; k++)
+        {
+            printf("%s{\"level\":%d,", k > 1 ? "," : "", k);
+            printReportCell(&totals, k);
+            putchar('}');
+        }
+        break;
+    case REPORT_DWELL:
+    {
+        // Coarse buckets for charts; percentiles come from the per-minute histogram
+        static const int edges[] = {15, 30, 60, 120, 240, 480, 1440, DWELL_MAX_MINUTES};
+        int low = 0;
+        for (int b = 0; b < 8; b++)
+        {
+            int64_t count = 0;
+            int high = b == 7 ? totals.keys : edges[b];
+            for (int k = low; k < high; k++)
+                count += totals.sessions[k];
+            printf("%s{\"from_minutes\":%d,\"to_minutes\":", b ? "," : "", low);
+            if (b == 7)
+                printf("null");
+            else
+                printf("%d", high);
+            printf(",\"sessions\":%lld}", (long long)count);
+            low = high;
+        }
+        printf("],\"avg_minutes\":%.1f,\"p50_minutes\":%d,\"p90_minutes\":%d,\"p99_minutes\":%d}\n",
+               totals.totalSessions ? totals.totalSeconds / 60.0 / totals.totalSessions : 0.0,
+               dwellPercentile(&totals, 0.5), dwellPercentile(&totals, 0.9),
+               dwellPercentile(&totals, 0.99));
+        freeReportTotals(&totals);
+        return 0;
+    }
+    case REPORT_TURNOVER:
+    {
+        // Turns per day over the requested range, or the whole store
+        ColumnStoreHeader header = {0};
+        FILE *file = openColumnStore(&header);
+        if (file != NULL)
+            fclose(file);
+        double start = from ? (double)from : (double)header.minTime;
+        double end = to ? (double)to : (double)header.maxTime;
+        double days = file != NULL && header.rows && end > start ? (end - start) / 86400.0 : 1.0;
+        if (days < 1.0)
+            days = 1.0;
+
+        for (int k = 1; k < totals.keys; k++)
+        {
+            printf("%s{\"spot\":%d,\"level\":%d,", k > 1 ? "," : "", k, spotLevel(k));
+            printReportCell(&totals, k);
+            printf(",\"turns_per_day\":%.2f,\"occupied_hours\":%.1f}",
+                   totals.sessions[k] / days, totals.seconds[k] / 3600.0);
+        }
+        break;
+    }
+    }
+    printf("]}\n");
+    freeReportTotals(&totals);
+    return 0;
+}
+
+/**
+ * statements [--mem MB]
+ *
+ * @return Process exit code
+ */
+int commandStatements(int argc, char *argv[])
+{
+    int megabytes = STATEMENT_DEFAULT_MEMORY_MB;
+    if (argc == 4 && strcmp(argv[2], "--mem") == 0)
+    {
+        if (sscanf(argv[3], "%d", &megabytes) != 1 || megabytes < 1)
+            return -1;
+    }
+    else if (argc != 2)
+        return -1;
+
+    StatementStats stats;
+    if (!generateStatements((size_t)megabytes * 1024 * 1024, &stats))
+        return printCommandError(OP_IO_ERROR);
+
+    printf("{\"ok\":true,\"file\":\"%s\",\"owners\":%d,\"sessions\":%lld,\"runs\":%d,\"merge_passes\":%d}\n",
+           FILENAME_STATEMENTS, stats.owners, stats.sessions, stats.runs, stats.passes);
+    return 0;
+}
+
+/**
+ * import <file.csv> [--threads N]
+ *
+ * @return Process exit code
+ */
+int commandImport(int argc, char *argv[])
+{
+    int threads = cpuCount();
+    if (argc == 5 && strcmp(argv[3], "--threads") == 0)
+    {
+        if (sscanf(argv[4], "%d", &threads) != 1 || threads < 1)
+            return -1;
+    }
+    else if (argc != 3)
+        return -1;
+    if (threads > IMPORT_MAX_THREADS)
+        threads = IMPORT_MAX_THREADS;
+
+    ImportStats stats;
+    OpStatus status = importHistory(argv[2], threads, &stats);
+    if (status != OP_OK)
+        return printCommandError(status);
+
+    printf("{\"ok\":true,\"rows\":%lld,\"imported\":%lld,\"duplicates\":%lld,"
+           "\"rejected\":{\"malformed\":%lld,\"invalid_time\":%lld",
+           stats.rows, stats.imported, stats.duplicates, stats.malformed, stats.invalidTime);
+    for (int i = OP_OK + 1; i < OP_IO_ERROR; i++)
+    {
+        if (stats.rejected[i] > 0)
+            printf(",\"%s\":%lld", opStatusCode((OpStatus)i), stats.rejected[i]);
+    }
+    printf("},\"errors\":[");
+    for (int i = 0; i < stats.errorCount; i++)
+        printf("%s{\"line\":%lld,\"error\":\"%s\"}", i ? "," : "", stats.errors[i].line, stats.errors[i].code);
+    printf("]}\n");
+    return 0;
+}
+
+/**
+ * purge [--days N] [--delete]
+ *
+ * @return Process exit code
+ */
+int commandPurge(int argc, char *argv[])
+{
+    int days = RETENTION_DAYS, deleteRows = RETENTION_DELETE;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--delete") == 0)
+            deleteRows = 1;
+        else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%d", &days) == 1 && days >= 0)
+            i++;
+        else
+            return -1;
+    }
+
+    RetentionStats stats;
+    if (!compactHistory(time(NULL) - (time_t)days * 86400, deleteRows, 0, 1, &stats))
+        return printCommandError(OP_IO_ERROR);
+
+    printf("{\"ok\":true,\"days\":%d,\"scanned\":%lld,\"anonymized\":%lld,\"deleted\":%lld,"
+           "\"bytes_before\":%ld,\"bytes_after\":%ld}\n",
+           days, stats.scanned, stats.anonymized, stats.deleted, stats.bytesBefore, stats.bytesAfter);
+    return 0;
+}
+
+/**
+ * verify [--repair]
+ *
+ * Exits with status 2 if discrepancies were found and not repaired.
+ *
+ * @return Process exit code
+ */
+int commandVerify(int argc, char *argv[])
+{
+    int repair = argc == 3 && strcmp(argv[2], "--repair") == 0;
+    if (argc != 2 && !repair)
+        return -1;
+
+    VerifyStats stats;
+    if (verifySpotState(repair, &stats) != OP_OK)
+        return printCommandError(OP_IO_ERROR);
+
+    int consistent = stats.missingRows + stats.staleRows == 0;
+    printf("{\"ok\":true,\"consistent\":%s,\"repair\":%s,\"threads\":%d,\"scanned\":%lld,"
+           "\"open_rows\":%d,\"occupied\":%d,\"no_open_row\":%d,\"stale_rows\":%d,\"repaired\":%d,"
+           "\"wall_ms\":%.1f,\"discrepancies\":[",
+           consistent ? "true" : "false", repair ? "true" : "false", stats.threads, stats.scanned,
+           stats.openRows, stats.occupied, stats.missingRows, stats.staleRows, stats.repaired,
+           stats.wallUs / 1000.0);
+    for (int i = 0; i < stats.listed; i++)
+    {
+        printf("%s{\"error\":\"%s\",\"spot\":%d,\"plate\":", i ? "," : "",
+               stats.list[i].code, stats.list[i].spot);
+        printJsonString(stats.list[i].plate);
+        printf(",\"entry_time\":%lld}", (long long)stats.list[i].entryTime);
+    }
+    printf("]}\n");
+    return consistent || repair ? 0 : 2;
+}
+
+/**
+ * Prints latency percentiles as a JSON object
+ *
+ * @param name Key
+ * @param sorted Latencies in microseconds, ascending
+ * @param count Number of latencies
+ */
+void printLatencySummary(const char *name, const unsigned *sorted, long long count)
+{
+    printf("\"%s\":{\"count\":%lld", name, count);
+    if (count > 0)
+        printf(",\"p50\":%u,\"p95\":%u,\"p99\":%u,\"max\":%u", sorted[count / 2],
+               sorted[count * 95 / 100], sorted[count * 99 / 100], sorted[count - 1]);
+    putchar('}');
+}
+
+/**
+ * simulate [--seed N] [--rate N] [--hours N] [--dwell exponential|lognormal|fixed]
+ *          [--mean MINUTES] [--profile flat|rush]
+ *
+ * @return Process exit code
+ */
+int commandSimulate(int argc, char *argv[])
+{
+    SimConfig config = {1, SIM_DEFAULT_RATE, SIM_DEFAULT_HOURS, SIM_DEFAULT_DWELL_MINUTES,
+                        DWELL_LOGNORMAL, 1};
+    for (int i = 2; i < argc; i += 2)
+    {
+        if (i + 1 == argc)
+            return -1;
+        const char *option = argv[i], *value = argv[i + 1];
+        int valid = 1;
+        if (strcmp(option, "--seed") == 0)
+            valid = sscanf(value, "%llu", &config.seed) == 1;
+        else if (strcmp(option, "--rate") == 0)
+            valid = sscanf(value, "%lf", &config.rate) == 1 && config.rate > 0;
+        else if (strcmp(option, "--hours") == 0)
+            valid = sscanf(value, "%d", &config.hours) == 1 && config.hours > 0;
+        else if (strcmp(option, "--mean") == 0)
+            valid = sscanf(value, "%lf", &config.dwellMinutes) == 1 && config.dwellMinutes > 0;
+        else if (strcmp(option, "--dwell") == 0)
+        {
+            if (strcmp(value, "exponential") == 0)
+                config.dwell = DWELL_EXPONENTIAL;
+            else if (strcmp(value, "lognormal") == 0)
+                config.dwell = DWELL_LOGNORMAL;
+            else if (strcmp(value, "fixed") == 0)
+                config.dwell = DWELL_FIXED;
+            else
+                valid = 0;
+        }
+        else if (strcmp(option, "--profile") == 0)
+        {
+            config.rushHour = strcmp(value, "rush") == 0;
+            valid = config.rushHour || strcmp(value, "flat") == 0;
+        }
+        else
+            valid = 0;
+        if (!valid)
+            return -1;
+    }
+
+    SimStats stats;
+    int result = runSimulation(&config, &stats);
+    if (result <= 0)
+    {
+        free(stats.parkUs);
+        free(stats.leaveUs);
+        if (result < 0)
+            fprintf(stderr, "%s/ holds data not written by the simulator; move it or use another directory\n",
+                    SIM_DIRECTORY);
+        return printCommandError(OP_IO_ERROR);
+    }
+
+    static const char *dwellNames[] = {"exponential", "lognormal", "fixed"};
+    double wallSeconds = stats.wallUs / 1e6;
+    long long operations = stats.parked + stats.turnedAway + stats.departures + stats.failures;
+    printf("{\"ok\":true,\"seed\":%llu,\"rate\":%.0f,\"hours\":%d,\"dwell\":\"%s\",\"mean_minutes\":%.1f,"
+           "\"profile\":\"%s\",\"spots\":%d,",
+           config.seed, config.rate, config.hours, dwellNames[config.dwell], config.dwellMinutes,
+           config.rushHour ? "rush" : "flat", PARKING_SPOTS);
+    printf("\"arrivals\":%lld,\"parked\":%lld,\"turned_away\":%lld,\"departures\":%lld,\"failures\":%lld,"
+           "\"peak_occupancy\":%d,\"mean_occupancy\":%.1f,\"revenue\":%.2f,",
+           stats.arrivals, stats.parked, stats.turnedAway, stats.departures, stats.failures,
+           stats.peakOccupancy, stats.meanOccupancy, stats.revenue);
+    printf("\"wall_ms\":%.0f,\"operations_per_sec\":%.0f,\"speedup\":%.0f,",
+           wallSeconds * 1000, wallSeconds > 0 ? operations / wallSeconds : 0,
+           wallSeconds > 0 ? config.hours * 3600.0 / wallSeconds : 0);
+    printLatencySummary("park_us", stats.parkUs, stats.parked);
+    putchar(',');
+    printLatencySummary("leave_us", stats.leaveUs, stats.departures);
+    printf(",\"checksum\":\"%016llx\"}\n", stats.checksum);
+    free(stats.parkUs);
+    free(stats.leaveUs);
+    return 0;
+}
+
+/**
+ * stats
+ *
+ * Prints the metrics file last written by the console, or this
+ * process's own counters and gauges if there is none. Output is
+ * Prometheus text, not JSON.
+ *
+ * @return Process exit code
+ */
+int commandStats(int argc, char *argv[])
+{
+    (void)argv;
+    if (argc != 2)
+        return -1;
+
+    FILE *file = openDataFile(FILENAME_METRICS, "r");
+    if (file != NULL)
+    {
+        char line[256];
+        while (fgets(line, sizeof(line), file))
+            fputs(line, stdout);
+        fclose(file);
+        return 0;
+    }
+
+    countParkedCars();  // Sets the occupancy gauge
+    writeMetrics(stdout);
+    return 0;
+}
+
+/**
+ * Prints command-line usage to stderr
+ *
+ * @param program Program name
+ */
+void printUsage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [--facility <id>] [command]\n"
+            "Without a command the interactive console is started.\n"
+            "--facility works on a site listed in " FILENAME_FACILITIES " (id,directory per line).\n\n"
+            "Commands (output is one JSON object on stdout):\n"
+            "  park <name> <plate> <phone> <address> <spot|0>\n"
+            "  leave <plate>\n"
+            "  lookup-plate <plate>\n"
+            "  lookup-owner <name>\n"
+            "  find-plate <plate> [--parked]\n"
+            "  occupancy\n"
+            "  reserve <plate> <spot|0> <from> <to> [--level N]\n"
+            "  cancel-reservation <id>\n"
+            "  availability <from> <to> [--level N]\n"
+            "         (times as \"YYYY-MM-DD HH:MM\")\n"
+            "  where-is <plate>        (all facilities)\n"
+            "  group-occupancy         (all facilities)\n"
+            "  export-columns\n"
+            "  report daily|hourly|level|dwell|turnover\n"
+            "         [--month YYYY-MM] [--from YYYY-MM-DD] [--to YYYY-MM-DD]\n"
+            "  statements [--mem MB]\n"
+            "  import <file.csv> [--threads N]\n"
+            "  purge [--days N] [--delete]\n"
+            "  verify [--repair]       (spot state against open history rows)\n"
+            "  simulate [--seed N] [--rate N] [--hours N] [--mean MINUTES]\n"
+            "           [--dwell exponential|lognormal|fixed] [--profile flat|rush]\n"
+            "  stats                   (Prometheus text)\n\n"
+            "Exit status: 0 ok, 1 usage error, 2 rejected, 3 data file error\n",
+            program);
+}
+
+/**
+ * Runs a one-shot command-line subcommand
+ *
+ * Uses the same park/leave/search logic as the screens, but without
+ * the console window, screen buffer or keyboard input, so a call
+ * costs little more than the file I/O it does.
+ *
+ * @param argc Argument count from main()
+ * @param argv Arguments from main(); argv[1] is the command
+ * @return Process exit code
+ */
+int runCommand(int argc, char *argv[])
+{
+    const char *command = argv[1];
+    int code = -1;
+
+    initializeParkingSpots();  // Create or verify parking spots file
+
+    if (strcmp(command, "park") == 0)
+        code = commandPark(argc, argv);
+    else if (strcmp(command, "leave") == 0)
+        code = commandLeave(argc, argv);
+    else if (strcmp(command, "lookup-plate") == 0)
+        code = commandLookup(argc, argv, SEARCH_BY_PLATE);
+    else if (strcmp(command, "lookup-owner") == 0)
+        code = commandLookup(argc, argv, SEARCH_BY_NAME);
+    else if (strcmp(command, "find-plate") == 0)
+        code = commandFindPlate(argc, argv);
+    else if (strcmp(command, "occupancy") == 0)
+        code = commandOccupancy(argc, argv);
+    else if (strcmp(command, "reserve") == 0)
+        code = commandReserve(argc, argv);
+    else if (strcmp(command, "cancel-reservation") == 0)
+        code = commandCancelReservation(argc, argv);
+    else if (strcmp(command, "availability") == 0)
+        code = commandAvailability(argc, argv);
+    else if (strcmp(command, "where-is") == 0)
+        code = commandWhereIs(argc, argv);
+    else if (strcmp(command, "group-occupancy") == 0)
+        code = commandGroupOccupancy(argc, argv);
+    else if (strcmp(command, "export-columns") == 0)
+        code = commandExportColumns(argc, argv);
+    else if (strcmp(command, "report") == 0)
+        code = commandReport(argc, argv);
+    else if (strcmp(command, "statements") == 0)
+        code = commandStatements(argc, argv);
+    else if (strcmp(command, "import") == 0)
+        code = commandImport(argc, argv);
+    else if (strcmp(command, "purge") == 0)
+        code = commandPurge(argc, argv);
+    else if (strcmp(command, "verify") == 0)
+        code = commandVerify(argc, argv);
+    else if (strcmp(command, "simulate") == 0)
+        code = commandSimulate(argc, argv);
+    else if (strcmp(command, "stats") == 0)
+        code = commandStats(argc, argv);
+    else if (strcmp(command, "help") == 0 || strcmp(command, "--help") == 0)
+    {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    if (code < 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    return code;
+}
+
+/**
+ * Main function - Entry point of the application
+ * 
+ * Runs a command-line subcommand when one is given; otherwise sets up
+ * the console environment, initializes the system, and handles the
+ * main program loop
+ * 
+ * @param argc Argument count
+ * @param argv Arguments
+ * @return 0 on successful execution
+ */
+int main(int argc, char *argv[])
+{
+    const char *metricsSetting = getenv("CARPARK_METRICS");
+    if (metricsSetting != NULL && strcmp(metricsSetting, "0") == 0)
+        metrics.enabled = 0;  // Runtime switch; compiled-in hooks then cost one branch
+    initFacility(&defaultFacility, "main", "");
+    if (loadFacilities() == 0)
+        facilities[facilityCount++] = &defaultFacility;  // Single site in the working directory
+
+    // --facility <id>: work on that site's data (command or console)
+    if (argc > 2 && strcmp(argv[1], "--facility") == 0)
+    {
+        currentFacility = findFacility(argv[2]);
+        if (currentFacility == NULL)
+        {
+            fprintf(stderr, "Unknown facility '%s' (see %s)\n", argv[2], FILENAME_FACILITIES);
+            return 1;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc > 1)
+    {
+#ifdef _WIN32
+        // GUI-subsystem build: write to the caller's console unless output is redirected
+        if (GetStdHandle(STD_OUTPUT_HANDLE) == NULL && AttachConsole(ATTACH_PARENT_PROCESS))
+        {
+            freopen("CONOUT$", "w", stdout);
+            freopen("CONOUT$", "w", stderr);
+        }
+#endif
+        return runCommand(argc, argv);
+    }
+
+#ifdef _WIN32
+    // Set up console for Windows GUI application
+    AllocConsole();
+    freopen("CONIN$", "r", stdin);     // Redirect standard input
+    freopen("CONOUT$", "w", stdout);   // Redirect standard output
+    freopen("CONOUT$", "w", stderr);   // Redirect standard error
+
+    // Set console title
+    SetConsoleTitleA("Car Park System");
+
+    // Set console size and buffer
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    COORD size = {SCREEN_WIDTH, SCREEN_HEIGHT};  // Width and height of console buffer
+    SetConsoleScreenBufferSize(hConsole, size);
+
+    // Set console window size
+    SMALL_RECT rect = {0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1};  // Left, top, right, bottom coordinates
+    SetConsoleWindowInfo(hConsole, TRUE, &rect);
+#else
+    fputs("\x1b]0;Car Park System\x07", stdout);  // Set terminal title
+#endif
+    initScreen();  // Prepare the off-screen console buffer
+
+    // Initialize system and display welcome screen
+    initializeParkingSpots();  // Create or verify parking spots file
+
+    // Reconcile spots and history after a crash between their writes
+    VerifyStats verify;
+    char message[64];
+    if (verifySpotState(VERIFY_ON_BOOT_REPAIR, &verify) != OP_OK)
+        postNotice(12, "Could not check parking data!");
+    else if (verify.missingRows + verify.staleRows == 0)
+        postNotice(11, "Welcome to Car Park System");  // Greeting fades on the menu
+    else
+    {
+        snprintf(message, sizeof(message), VERIFY_ON_BOOT_REPAIR ? "Repaired %d spot/history mismatches"
+                 : "%d spot/history mismatches (run verify)", verify.missingRows + verify.staleRows);
+        postNotice(14, message);
+    }
+    startGroupCommitWriter();  // Start batched writer for spot/history updates
+    startRetentionTask();      // Expire old personal data in the background
+
+    // Main program loop
+    int running = 1;
+    while (running)
+    {
+        mainMenu();  // Display main menu options
+        int choice = readKeyLive(1, drawParkedCount);  // Get selection, keeping the counter live
+
+        // Process user selection
+        switch (choice)
+        {
+        case '1':
+            displayParkingStatus();  // Show parking spot grid
+            break;
+        case '2':
+            addCar();  // Add a new car to parking
+            break;
+        case '3':
+            removeCar();  // Remove a car from parking
+            break;
+        case '4':
+            searchMenu();  // Show search submenu
+            break;
+        case '5':
+        case EOF:         // Input closed
+            running = 0;  // Exit the program
+            break;
+        default:
+            // Handle invalid input
+            postNotice(12, "Invalid choice!");
+        }
+    }
+
+    // Show exit screen and terminate
+    if (metrics.enabled)
+        exportMetrics();
+    exitScreen();
+    return 0;
 }
\ No newline at end of file